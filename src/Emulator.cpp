@@ -16,6 +16,7 @@
 #include "ThreadArgs.h"
 
 #include "core/GameBoy.h"
+#include "debug/Lockstep.h"
 
 #include "common/Types.h"
 #include "common/Globals.h"
@@ -24,17 +25,18 @@
 #include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <thread>
+#include <utility>
 
 static u8 bootrom_raw[] = {
 	#include "roms/DMG_ROM.h"
 };
 
-static u8 rom_raw[] = {
-	#include "roms/rom.h"
-};
+// Cartridge loaded when none is given on the command line
+static const char* DEFAULT_ROM_PATH = "sdmc:/3ds/JaxBoy/rom.gb";
 
 
 int main(int argc, char* argv[])
@@ -44,17 +46,36 @@ int main(int argc, char* argv[])
     consoleInit(GFX_BOTTOM, NULL);
 
 
-    std::vector<u8> rom(rom_raw, rom_raw + sizeof(rom_raw));
-    std::vector<u8> bootrom(bootrom_raw, bootrom_raw + sizeof(bootrom_raw));
-
-
     // Setup system options
     Core::GameBoy::Options options;
 
+    std::string rom_path = (argc > 1)? argv[1] : DEFAULT_ROM_PATH;
+    std::unique_ptr<Core::RomImage> rom;
+    if(options.rom_compressed)
+        rom = Core::RomImage::OpenCompressed(rom_path, options.rom_pool_banks);
+    else if(options.rom_pool_banks > 0)
+        rom = Core::RomImage::OpenPaged(rom_path, options.rom_pool_banks);
+    else
+        rom = Core::RomImage::Open(rom_path);
+    if(!rom) {
+        printf("Couldn't open %s\n", rom_path.c_str());
+        gfxExit();
+        return 1;
+    }
+    std::vector<u8> bootrom(bootrom_raw, bootrom_raw + sizeof(bootrom_raw));
+
+
     int width = 160;
     int height = 144;
     // Create the system instance
-    Core::GameBoy* gameboy = ( new Core::GameBoy(options, width, height, rom, bootrom) );
+    Core::GameBoy* gameboy = nullptr;
+    Debug::Lockstep* lockstep = nullptr;
+    if(options.lockstep) {
+        lockstep = new Debug::Lockstep(options, width, height, std::move(rom), bootrom);
+        gameboy = lockstep->GetGameBoy().get();
+    } else {
+        gameboy = new Core::GameBoy(options, width, height, std::move(rom), bootrom);
+    }
     // Initalize Render Context
     FrontEnd::SDLContext* sdl_context = new FrontEnd::SDLContext(width, height, options.scale, gameboy);
 
@@ -80,7 +101,14 @@ int main(int argc, char* argv[])
     {
         while(aptMainLoop())
         {
-            gameboy->Cycle();
+            if(lockstep)
+            {
+                // Stop at the first divergence; Step has logged it
+                if(!lockstep->Step())
+                    break;
+            }
+            else
+                gameboy->RunFrame();
 
             //sdl_context->Update(gameboy->GetPPU()->GetBackBuffer());
             /*update_frame = true;
@@ -92,9 +120,23 @@ int main(int argc, char* argv[])
         }
     }
 
+    if(lockstep && lockstep->HasDiverged())
+    {
+        printf("Lockstep stopped after %lu steps, press START to exit\n", lockstep->GetSteps());
+        while(aptMainLoop())
+        {
+            gspWaitForVBlank();
+            hidScanInput();
+            if(hidKeysDown() & KEY_START)
+                break;
+        }
+    }
+
     //threadJoin(sdl_thread, U64_MAX);
     //threadFree(sdl_thread);
-    if(gameboy)
+    if(lockstep)
+        delete lockstep;
+    else if(gameboy)
         delete gameboy;
     if(sdl_context) {
         //sdl_context->Destroy();
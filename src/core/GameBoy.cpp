@@ -15,6 +15,7 @@
 #include "GameBoy.h"
 #include "PPU.h"
 #include "Rom.h"
+#include "Timer.h"
 #include "processor/Processor.h"
 #include "memory/MemoryBus.h"
 
@@ -23,6 +24,7 @@
 #include "../debug/Logger.h"
 
 #include <string>
+#include <utility>
 
 
 namespace Core {
@@ -30,23 +32,37 @@ namespace Core {
 GameBoy::GameBoy(GameBoy::Options& options,
                  int width,
                  int height,
-                 const std::vector<u8>& rom,
+                 std::unique_ptr<RomImage> rom,
                  const std::vector<u8>& bootrom)
 :
     _Options (options)
 {
     memory_bus = std::make_shared<Memory::MemoryBus>(this);
+    // Joypad and serial registers live here
+    Memory::IORegister& p1 = memory_bus->RegisterIO(0xFF00, this, &P1);
+    p1.write = Memory::IOWrite<GameBoy, &GameBoy::WriteP1>;
+    p1.read_mask = 0x3F;
+    memory_bus->RegisterIO(0xFF01, this, &SB);
+    Memory::IORegister& sc = memory_bus->RegisterIO(0xFF02, this, &SC);
+    sc.write = Memory::IOWrite<GameBoy, &GameBoy::WriteSC>;
+    sc.read_mask = 0x81;
 
     processor = std::unique_ptr<Processor> (new Processor(this, memory_bus));
-    ppu = std::unique_ptr<PPU> (new PPU(this, width, height, memory_bus));
+    ppu = std::unique_ptr<PPU> (new PPU(this, width, height, memory_bus, scheduler));
+    timer = std::unique_ptr<Timer> (new Timer(memory_bus, scheduler));
 
-    game_rom = std::unique_ptr<Rom> (new Rom(rom, options.force_mbc));
+    game_rom = std::unique_ptr<Rom> (new Rom(std::move(rom), options.force_mbc));
     // load ROM at 0x0000-0x7FFF
     memory_bus->InitMBC(game_rom);
 
+    if(_Options.debug) {
+        tracer = std::unique_ptr<Debug::Tracer> (new Debug::Tracer(_Options.trace_path));
+        processor->SetTracer(tracer.get());
+    }
+
     if(!_Options.skip_bootrom) {
-        // load boot ROM at 0x0000-0x00FF
-        memory_bus->WriteBytes(bootrom.data(), 0x0000, 0x0100);
+        // lay the boot ROM over 0x0000-0x00FF
+        memory_bus->MapBootROM(bootrom);
         InBootROM = true;
     }
     
@@ -65,14 +81,110 @@ void GameBoy::Cycle()
             return;
     }
 
-    int cycles = processor->Tick();
-        
-    if(ppu->Update(cycles) == -1)
+    processor->Run(FRAME_CYCLES);
+    if(scheduler.HasDue())
+        RunEvents();
+
+    UpdateKeys();
+}
+
+GameBoy::RunResult GameBoy::RunCycles(int cycles, bool stop_on_frame)
+{
+    RunResult result;
+    u32 frame = ppu->GetFrameCount();
+    u64 halted = processor->GetHaltedCycles();
+    u64 idle = processor->GetIdleLoops().GetStats().skipped_cycles;
+
+    UpdateKeys();
+
+    while(result.cycles < cycles)
     {
-        Stop();
+        if(Stopped)
+        {
+            result.reason = RunResult::STOP_HALTED;
+            break;
+        }
+
+        result.cycles += processor->Run(cycles - result.cycles);
+
+        if(keys_dirty)
+        {
+            keys_dirty = false;
+            UpdateKeys();
+        }
+
+        // Everything else only happens when an event is due
+        if(scheduler.HasDue())
+        {
+            RunEvents();
+            if(ppu->GetFrameCount() != frame)
+            {
+                result.frame_completed = true;
+                if(stop_on_frame)
+                {
+                    result.reason = RunResult::STOP_FRAME;
+                    break;
+                }
+            }
+        }
     }
 
-    UpdateKeys();
+    result.halted_cycles = static_cast<int>(processor->GetHaltedCycles() - halted);
+    result.idle_cycles = static_cast<int>(processor->GetIdleLoops().GetStats().skipped_cycles - idle);
+    return result;
+}
+
+void GameBoy::RunEvents()
+{
+    EventType type;
+    u64 late;
+    while(scheduler.PopDue(type, late))
+    {
+        switch(type)
+        {
+        case EVENT_PPU:
+            ppu->Update(late); break;
+        case EVENT_TIMER:
+            timer->Overflow(late); break;
+        case EVENT_DMA:
+            processor->FinishDMATransfer(); break;
+        case EVENT_SERIAL:
+            FinishSerialTransfer(); break;
+        default:
+            break;
+        }
+    }
+}
+
+void GameBoy::WriteP1(u8 data)
+{
+    // Only the select bits are writable; 0x30 means no controller polling
+    P1 = (P1 & 0x0F) | (data & 0x30);
+    keys_dirty = true;
+}
+
+void GameBoy::WriteSC(u8 data)
+{
+    SC = data;
+    StartSerialTransfer();
+}
+
+void GameBoy::StartSerialTransfer()
+{
+    // 8 bits at 8192Hz on the internal clock; with an
+    // external clock nothing happens until a partner clocks it
+    if((SC & 0x81) == 0x81)
+        scheduler.Schedule(EVENT_SERIAL, 8 * 512);
+    else
+        scheduler.Cancel(EVENT_SERIAL);
+}
+
+void GameBoy::FinishSerialTransfer()
+{
+    // Nothing is connected, so all ones are shifted in
+    SB = 0xFF;
+    SC &= ~0x80;
+    memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x08);
 }
 
 void GameBoy::UpdateKeys()
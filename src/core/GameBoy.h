@@ -14,12 +14,17 @@
 
 #pragma once
 #include "Rom.h"
+#include "RomImage.h"
 #include "PPU.h"
+#include "Scheduler.h"
+#include "Timer.h"
 #include "processor/Processor.h"
 
 #include "../common/Types.h"
+#include "../debug/Tracer.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 
@@ -31,6 +36,7 @@ namespace Core {
 class Processor;
 class PPU;
 class Rom;
+class Timer;
 
 class GameBoy
 {
@@ -40,22 +46,82 @@ public:
 
     struct Options
     {
+        // Write a binary trace of every instruction run to trace_path
         bool debug = false;
+        std::string trace_path = "trace.bin";
         int scale = 1;
         int force_mbc = -1;
         bool skip_bootrom = false;
         bool framelimiter_hack = false;
+        // Run ROM code out of the pre-decoded block cache
+        bool block_cache = false;
+        // Compile hot blocks to host code; only on x86-64,
+        // and only with the block cache on
+        bool jit = false;
+        // Check the block cache against the interpreter as it runs
+        bool lockstep = false;
+        // Draw frames to memory only and leave the screen alone
+        bool headless = false;
+        // Fast-forward through loops that only poll for the next event
+        bool idle_loop_skip = true;
+        // Leave lines alone that would be drawn just as they were
+        bool line_skip = true;
+        // Draw those lines anyway and stop if one comes out different
+        bool verify_line_skip = false;
+        // Draw the whole frame at V-Blank from what each line was
+        // set up with, rather than each line as it is reached
+        bool deferred_render = false;
+        // Keep only this many switchable ROM banks in memory and read
+        // the rest from the file on demand; 0 loads the whole ROM
+        int rom_pool_banks = 0;
+        // Hold the ROM LZ4-compressed and unpack banks into the pool above
+        bool rom_compressed = false;
     };
     Options& GetOptions()
         { return _Options; }
 
+    // Roughly one frame's worth of cycles
+    static const int FRAME_CYCLES = 70224;
+
+    struct RunResult
+    {
+        enum StopReason
+        {
+            // Used up the cycle budget
+            STOP_BUDGET,
+            // The PPU entered V-Blank
+            STOP_FRAME,
+            // The system was stopped
+            STOP_HALTED
+        };
+        int cycles = 0;
+        // Cycles fast-forwarded while the CPU was halted
+        int halted_cycles = 0;
+        // Cycles fast-forwarded in idle loops
+        int idle_cycles = 0;
+        bool frame_completed = false;
+        StopReason reason = STOP_BUDGET;
+
+        // Share of the run skipped over in HALT
+        float HaltedShare() const
+            { return (cycles > 0)? static_cast<float>(halted_cycles) / cycles : 0.0f; }
+    };
+
     GameBoy(GameBoy::Options& options,
             int width,
             int height,
-            const std::vector<u8>& rom,
+            std::unique_ptr<RomImage> rom,
             const std::vector<u8>& bootrom);
 
+    // Runs one instruction, or with the block cache on, one run
+    // of cached code, and then anything that has come due
     void Cycle();
+    // Run instructions until at least the given number of cycles
+    // have passed, a frame completes or the system stops
+    RunResult RunCycles(int cycles, bool stop_on_frame = false);
+    // Gives up after two frames' worth of cycles if the LCD is off
+    RunResult RunFrame()
+        { return RunCycles(FRAME_CYCLES * 2, true); }
     void Stop()
         { Stopped = true; }
     bool IsStopped()
@@ -66,8 +132,16 @@ public:
         { return game_rom; };
     std::unique_ptr<PPU>& GetPPU()
         { return ppu; }
+    std::unique_ptr<Processor>& GetProcessor()
+        { return processor; }
+    std::shared_ptr<Memory::MemoryBus>& GetMemoryBus()
+        { return memory_bus; }
+    Scheduler& GetScheduler()
+        { return scheduler; }
 
     void UpdateKeys();
+    bool KeysDirty()
+        { return keys_dirty; }
     void KeyPressed(u8 key);
     void KeyReleased(u8 key);
 
@@ -79,22 +153,34 @@ public:
 
 private:
     friend class Memory::MemoryBus;
+    friend class Recompiler;
 
     // P1 IO Register
     u8 P1;
     // Keys currently pressed
     u8 Keys;
-    // Timer registers
-    u8 TIMA; // timer counter; incremented at TAC frequency
-    u8 TMA;  // timer modulo; when timer overflows, loads this value
-    u8 TAC;  // timer control; control speed of TIMA
+    // P1 was written and needs refreshing
+    bool keys_dirty = false;
+    void WriteP1(u8 data);
+    // Serial registers; there is never a link partner
+    u8 SB = 0x00;
+    u8 SC = 0x00;
+    void WriteSC(u8 data);
+    void StartSerialTransfer();
+    void FinishSerialTransfer();
+
+    // Timed events for every component
+    Scheduler scheduler;
+    void RunEvents();
 
     // Options configuration
     GameBoy::Options _Options;
     // Components
     std::unique_ptr<Processor> processor;
     std::unique_ptr<PPU> ppu;
+    std::unique_ptr<Timer> timer;
     std::unique_ptr<Rom> game_rom;
+    std::unique_ptr<Debug::Tracer> tracer;
     // System memory map
     std::shared_ptr<Memory::MemoryBus> memory_bus;
 
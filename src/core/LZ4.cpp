@@ -0,0 +1,168 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "LZ4.h"
+
+#include <cstring>
+
+
+static const int HASH_BITS = 12;
+static const u32 MIN_MATCH = 4;
+// The format wants the last 5 bytes as literals, and
+// no match starting within 12 bytes of the end
+static const u32 LAST_LITERALS = 5;
+static const u32 MATCH_MARGIN = 12;
+
+static u32 Read32(const u8* p)
+{
+    u32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static u32 Hash(u32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and up spill into extra bytes
+static void WriteLength(std::vector<u8>& out, u32 length)
+{
+    while(length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(length);
+}
+
+static bool ReadLength(const u8*& ip, const u8* iend, u32& length)
+{
+    u8 byte;
+    do
+    {
+        if(ip >= iend)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while(byte == 255);
+    return true;
+}
+
+static void WriteSequence(std::vector<u8>& out, const u8* literals, u32 literal_length,
+                          u32 offset, u32 match_length)
+{
+    u32 match_code = (match_length >= MIN_MATCH)? match_length - MIN_MATCH : 0;
+    u8 token = ((literal_length < 15)? literal_length : 15) << 4;
+    if(match_length >= MIN_MATCH)
+        token |= (match_code < 15)? match_code : 15;
+    out.push_back(token);
+    if(literal_length >= 15)
+        WriteLength(out, literal_length - 15);
+    out.insert(out.end(), literals, literals + literal_length);
+
+    // The last sequence is literals only
+    if(match_length < MIN_MATCH)
+        return;
+    out.push_back(offset & 0xFF);
+    out.push_back(offset >> 8);
+    if(match_code >= 15)
+        WriteLength(out, match_code - 15);
+}
+
+
+namespace Core {
+namespace LZ4 {
+
+std::vector<u8> Compress(const u8* src, u32 size)
+{
+    std::vector<u8> out;
+    out.reserve(size + size / 255 + 16);
+    std::vector<s32> table(1 << HASH_BITS, -1);
+
+    u32 anchor = 0;
+    u32 pos = 0;
+    u32 match_limit = (size > MATCH_MARGIN)? size - MATCH_MARGIN : 0;
+    while(pos < match_limit)
+    {
+        u32 sequence = Read32(src + pos);
+        u32 hash = Hash(sequence);
+        s32 ref = table[hash];
+        table[hash] = pos;
+        if(ref < 0 || pos - ref > 0xFFFF || Read32(src + ref) != sequence)
+        {
+            pos++;
+            continue;
+        }
+
+        u32 length = MIN_MATCH;
+        while(pos + length < size - LAST_LITERALS && src[ref + length] == src[pos + length])
+            length++;
+        WriteSequence(out, src + anchor, pos - anchor, pos - ref, length);
+        pos += length;
+        anchor = pos;
+    }
+    WriteSequence(out, src + anchor, size - anchor, 0, 0);
+
+    return out;
+}
+
+bool Decompress(const u8* src, u32 src_size, u8* dst, u32 dst_size)
+{
+    const u8* ip = src;
+    const u8* iend = src + src_size;
+    u8* op = dst;
+    u8* oend = dst + dst_size;
+
+    while(ip < iend)
+    {
+        u8 token = *ip++;
+
+        u32 literal_length = token >> 4;
+        if(literal_length == 15 && !ReadLength(ip, iend, literal_length))
+            return false;
+        if(literal_length > static_cast<u32>(iend - ip) ||
+           literal_length > static_cast<u32>(oend - op))
+            return false;
+        std::memcpy(op, ip, literal_length);
+        op += literal_length;
+        ip += literal_length;
+        // Only the last sequence ends after its literals
+        if(ip == iend)
+            break;
+
+        if(iend - ip < 2)
+            return false;
+        u32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > static_cast<u32>(op - dst))
+            return false;
+        u32 match_length = token & 0x0F;
+        if(match_length == 15 && !ReadLength(ip, iend, match_length))
+            return false;
+        match_length += MIN_MATCH;
+        if(match_length > static_cast<u32>(oend - op))
+            return false;
+
+        // Matches may overlap what they're writing
+        const u8* match = op - offset;
+        while(match_length--)
+            *op++ = *match++;
+    }
+
+    return op == oend;
+}
+
+}; // namespace LZ4
+}; // namespace Core
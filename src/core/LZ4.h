@@ -0,0 +1,30 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../common/Types.h"
+
+#include <vector>
+
+
+namespace Core {
+// LZ4 block format, enough of it to pack ROM banks;
+// streams written by the reference encoder decode fine
+namespace LZ4 {
+    std::vector<u8> Compress(const u8* src, u32 size);
+    // Fails unless the block decodes to exactly dst_size bytes
+    bool Decompress(const u8* src, u32 src_size, u8* dst, u32 dst_size);
+}; // namespace LZ4
+}; // namespace Core
@@ -13,36 +13,105 @@
 // limitations under the License.
 
 #include "PPU.h"
+#include "GameBoy.h"
+#include "Scheduler.h"
 #include "memory/MemoryBus.h"
 
 #include "../common/Globals.h"
 
 #include <3ds.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <string>
 
 
+namespace Graphics {
+
+static constexpr u16 Spread(int bits)
+{
+    return ((bits & 0x01) << 0) | ((bits & 0x02) << 1) | ((bits & 0x04) << 2) | ((bits & 0x08) << 3) |
+           ((bits & 0x10) << 4) | ((bits & 0x20) << 5) | ((bits & 0x40) << 6) | ((bits & 0x80) << 7);
+}
+#define SPREAD4(n)  Spread(n), Spread(n + 1), Spread(n + 2), Spread(n + 3)
+#define SPREAD16(n) SPREAD4(n), SPREAD4(n + 4), SPREAD4(n + 8), SPREAD4(n + 12)
+#define SPREAD64(n) SPREAD16(n), SPREAD16(n + 16), SPREAD16(n + 32), SPREAD16(n + 48)
+const u16 BIT_SPREAD[256] = { SPREAD64(0), SPREAD64(64), SPREAD64(128), SPREAD64(192) };
+#undef SPREAD64
+#undef SPREAD16
+#undef SPREAD4
+
+}; // namespace Graphics
+
 namespace Core {
 
+const int PPU::LINES;
+
 PPU::PPU(GameBoy* gameboy, int width, int height,
-         std::shared_ptr<Memory::MemoryBus>& memory_bus)
+         std::shared_ptr<Memory::MemoryBus>& memory_bus,
+         Scheduler& scheduler)
 :
+    width (width),
+    height (height),
     gameboy (gameboy),
     memory_bus (memory_bus),
-    width (width),
-    height (height)
+    scheduler (scheduler)
 {
     // initialize buffers
     back_buffer = std::vector<Color>(width * height);
-    BGTileset = std::vector<Graphics::Tile>(256);
-    OBJTileset = std::vector<Graphics::Tile>(256);
-    // Start in DISPLAY_VBLANK
-    STAT |= DISPLAY_VBLANK;
+    std::memset(fb_signatures, 0, sizeof(fb_signatures));
+    std::memset(line_signatures, 0, sizeof(line_signatures));
+    line_skip = gameboy->GetOptions().line_skip;
+    verify_line_skip = gameboy->GetOptions().verify_line_skip;
+    deferred_render = gameboy->GetOptions().deferred_render;
+    headless = gameboy->GetOptions().headless;
+    if(headless)
+    {
+        headless_frames[0] = std::vector<Color>(width * height);
+        headless_frames[1] = std::vector<Color>(width * height);
+    }
+    bg_layer.pixels = std::vector<Color>(LAYER_SIZE * LAYER_SIZE);
+    window_layer.pixels = std::vector<Color>(LAYER_SIZE * LAYER_SIZE);
+    tiles = std::vector<Graphics::Tile>(TILE_COUNT);
+    // Nothing is known about the maps until they are read
+    for(MapIndex& index : map_indexes)
+    {
+        std::memset(index.entries, 0, sizeof(index.entries));
+        std::fill(index.entries[0], index.entries[0] + 32, 0xFFFFFFFF);
+        std::memset(index.ids, 0, sizeof(index.ids));
+        std::fill(index.written, index.written + 32, 0xFFFFFFFF);
+        index.stale = true;
+    }
+    // Decode everything before the first line is drawn
+    std::fill(dirty_tiles, dirty_tiles + (TILE_COUNT / 32), 0xFFFFFFFF);
+    tiles_dirty = true;
+    memory_bus->WatchWrites(0x80, 0x97, this, MarkTileDirty);
+    memory_bus->WatchWrites(0x98, 0x9F, this, MarkMapDirty);
+    memory_bus->WatchWrites(0xFE, 0xFE, this, MarkSpritesDirty);
+    // Start at the top of the screen with the LCD on
+    LY = 0;
+    STAT = DISPLAY_OAMACCESS;
     LCDC = 0x91;
+    scheduler.Schedule(EVENT_PPU, OAM_CYCLES);
     // Setup blank palettes
-    BGPalette[0] = BGPalette[1] = BGPalette[2] = BGPalette[3] = gColors[0x00];
-    OBJ0Palette[0] = OBJ0Palette[1] = OBJ0Palette[2] = OBJ0Palette[3] = gColors[0x00];
-    OBJ1Palette[0] = OBJ1Palette[1] = OBJ1Palette[2] = OBJ1Palette[3] = gColors[0x00];
+    WriteBGP(0x00);
+    WriteOBP0(0x00);
+    WriteOBP1(0x00);
+
+    // Hook up the IO registers
+    memory_bus->RegisterIO(0xFF40, this, &LCDC).write = Memory::IOWrite<PPU, &PPU::WriteLCDC>;
+    memory_bus->RegisterIO(0xFF41, this, &STAT).write = Memory::IOWrite<PPU, &PPU::WriteSTAT>;
+    memory_bus->RegisterIO(0xFF42, this, &SCY);
+    memory_bus->RegisterIO(0xFF43, this, &SCX);
+    memory_bus->RegisterIO(0xFF44, this, &LY).write = Memory::IOWrite<PPU, &PPU::WriteLY>;
+    memory_bus->RegisterIO(0xFF45, this, &LYC);
+    memory_bus->RegisterIO(0xFF47, this, &BGP).write = Memory::IOWrite<PPU, &PPU::WriteBGP>;
+    memory_bus->RegisterIO(0xFF48, this, &OBP0).write = Memory::IOWrite<PPU, &PPU::WriteOBP0>;
+    memory_bus->RegisterIO(0xFF49, this, &OBP1).write = Memory::IOWrite<PPU, &PPU::WriteOBP1>;
+    memory_bus->RegisterIO(0xFF4A, this, &WY);
+    memory_bus->RegisterIO(0xFF4B, this, &WX);
 }
 
 std::vector<Color>& PPU::GetBackBuffer()
@@ -50,153 +119,337 @@ std::vector<Color>& PPU::GetBackBuffer()
     return back_buffer;
 }
 
-int PPU::Update(int cycles)
+void PPU::Update(u64 late)
 {
-    int return_code = 0;
-    if(LCDC & 0x80)
+    int next = 0;
+    switch(STAT & 0x03)
     {
-        frameCycles += cycles;
-        switch(STAT & 0x03)
+        case DISPLAY_OAMACCESS:
+            FetchScanlineSprites();
+            STAT = (STAT & ~0x03) | DISPLAY_UPDATE;
+            next = TRANSFER_CYCLES;
+            break;
+        case DISPLAY_UPDATE:
         {
-            case DISPLAY_HBLANK:
-                // TODO: Accurate cycles?
-                if(frameCycles > 207)
-                {
-                    // Draw this scanline
-                    DrawScanline();
-                    // Carry leftover cycles into next mode
-                    frameCycles %= 207;
-                    if(++LY == 144)
-                    {
-                        // At the last line; enter V-Blank
-                        STAT = (STAT & ~0x03) | DISPLAY_VBLANK;
-                        // request V-Blank interrupt
-                        memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x01);
-                    }
-                    else
-                    {
-                        // Proceed to the next line
-                        STAT = (STAT & ~0x03) | DISPLAY_OAMACCESS;
-                    }
-
-                    if(LY == LYC) {
-                        // If LY == LYC set the coincidence bits in STAT and trigger the interrupt
-                        // (I don't know why there are two coincidence bits)
-                        STAT |= 0x44;
-                        memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x02);
-                    } else {
-                        STAT &= ~0x44;
-                    }
-                }
-                break;
-            case DISPLAY_VBLANK:
-                // Have we completed a scanline?
-                if((static_cast<int>(frameCycles / 465) + 144) > LY)
-                {
-                    if(++LY > 153)
-                    {
-                        frameCycles %= 4560;
-                        STAT = (STAT & ~0x03) | DISPLAY_OAMACCESS;
-                        LY = 0;
-                        // Flush and swap framebuffers
-                        gfxFlushBuffers();
-                        gfxSwapBuffers();
-
-                        //Wait for VBlank
-                        gspWaitForVBlank();
-                    }
-                }
-                break;
-            case DISPLAY_OAMACCESS:
-                if(frameCycles > 83)
-                {
-                    FetchScanlineSprites();
-                    frameCycles %= 83;
-                    STAT = (STAT & ~0x03) | DISPLAY_UPDATE;
-                }
-                break;
-            case DISPLAY_UPDATE:
-                if(frameCycles > 175)
+            LineSignature signature;
+            SignLine(signature);
+            if(deferred_render)
+            {
+                // Keep what the line needs for drawing it at V-Blank
+                PendingLine& pending = pending_lines[pending_count++];
+                pending.LY = LY;
+                pending.signature = signature;
+                if(pending_count == LINES)
+                    DrawPendingLines();
+            }
+            else
+            {
+                DecodeTiles();
+                // Draw this scanline
+                DrawLine(signature);
+            }
+            STAT = (STAT & ~0x03) | DISPLAY_HBLANK;
+            next = HBLANK_CYCLES;
+            break;
+        }
+        case DISPLAY_HBLANK:
+            if(++LY == 144)
+            {
+                // At the last line; enter V-Blank
+                STAT = (STAT & ~0x03) | DISPLAY_VBLANK;
+                DrawPendingLines();
+                frameCount++;
+                stats.frame_tiles_decoded = frame_tiles_decoded;
+                frame_tiles_decoded = 0;
+                stats.frame_sprite_eval_ns = frame_sprite_eval_ns;
+                frame_sprite_eval_ns = 0;
+                stats.frame_lines_skipped = frame_lines_skipped;
+                frame_lines_skipped = 0;
+                // request V-Blank interrupt
+                memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x01);
+                next = LINE_CYCLES;
+            }
+            else
+            {
+                // Proceed to the next line
+                STAT = (STAT & ~0x03) | DISPLAY_OAMACCESS;
+                next = OAM_CYCLES;
+            }
+            CompareLY();
+            break;
+        case DISPLAY_VBLANK:
+            if(++LY > 153)
+            {
+                STAT = (STAT & ~0x03) | DISPLAY_OAMACCESS;
+                LY = 0;
+                next = OAM_CYCLES;
+                framebuffer ^= 1;
+                if(!headless)
                 {
-                    frameCycles %= 175;
-                    STAT = (STAT & ~0x03) | DISPLAY_HBLANK;
-                    DecodeTiles();
+                    // Flush and swap framebuffers
+                    gfxFlushBuffers();
+                    gfxSwapBuffers();
+
+                    //Wait for VBlank
+                    gspWaitForVBlank();
                 }
-                break;
-        }
+            }
+            else
+            {
+                next = LINE_CYCLES;
+            }
+            CompareLY();
+            break;
+    }
+
+    // Stay in step even if we were serviced a few cycles late
+    scheduler.Schedule(EVENT_PPU, (late < static_cast<u64>(next))? next - late : 0);
+}
+
+void PPU::CompareLY()
+{
+    if(LY == LYC) {
+        // If LY == LYC set the coincidence bits in STAT and trigger the interrupt
+        // (I don't know why there are two coincidence bits)
+        STAT |= 0x44;
+        memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x02);
+    } else {
+        STAT &= ~0x44;
+    }
+}
+
+void PPU::WriteLCDC(u8 data)
+{
+    bool enabled = (LCDC & 0x80) != 0;
+    if(enabled && !(data & 0x80))
+        DrawPendingLines();
+    LCDC = data;
+
+    if(enabled && !(LCDC & 0x80))
+    {
+        // Turning the LCD off stops the PPU at the top of the screen
+        scheduler.Cancel(EVENT_PPU);
+        LY = 0;
+        STAT &= ~0x03;
     }
-    else
+    else if(!enabled && (LCDC & 0x80))
     {
-        // If LCDC is disabled, reset all this stuff
-        frameCycles = 0;
+        // and turning it back on restarts it there
         LY = 0;
+        STAT = (STAT & ~0x03) | DISPLAY_OAMACCESS;
+        CompareLY();
+        scheduler.Schedule(EVENT_PPU, OAM_CYCLES);
+    }
+}
+
+void PPU::WriteSTAT(u8 data)
+{
+    // The mode and coincidence bits are read-only
+    STAT = (data & 0x78) | (STAT & 0x07);
+}
+
+void PPU::WriteLY(u8 data)
+{
+    // Writing to this resets it
+    LY = 0;
+}
+
+// Each two bits of a palette register pick one of the four shades
+static void DecodePalette(Color* palette, u8 data)
+{
+    for(int i = 0; i < 4; i++)
+        palette[i] = gColors[(data >> (i * 2)) & 0x03];
+}
+
+void PPU::WriteBGP(u8 data)
+{
+    BGP = data;
+    DecodePalette(BGPalette, data);
+    // The top two bits of each half are its leftmost pixel
+    for(int bits = 0; bits < 256; bits++)
+    {
+        for(int px = 0; px < 4; px++)
+            bg_row_colors[bits][px] = BGPalette[(bits >> (6 - (px * 2))) & 0x03];
+    }
+}
+
+// Both orders of every pixel pair under a sprite palette;
+// color 0 is transparent, so its mask is empty
+static void BuildPixelPairs(const Color* palette, Graphics::PixelPair (*pairs)[16])
+{
+    for(int bits = 0; bits < 16; bits++)
+    {
+        int left = bits >> 2;
+        int right = bits & 0x03;
+        Graphics::PixelPair& pair = pairs[0][bits];
+        pair.color[0] = palette[left];
+        pair.color[1] = palette[right];
+        pair.mask[0] = (left != 0)? 0xFFFFFFFF : 0;
+        pair.mask[1] = (right != 0)? 0xFFFFFFFF : 0;
+        Graphics::PixelPair& mirrored = pairs[1][bits];
+        mirrored.color[0] = pair.color[1];
+        mirrored.color[1] = pair.color[0];
+        mirrored.mask[0] = pair.mask[1];
+        mirrored.mask[1] = pair.mask[0];
+    }
+}
+
+void PPU::WriteOBP0(u8 data)
+{
+    OBP0 = data;
+    DecodePalette(OBJ0Palette, data);
+    BuildPixelPairs(OBJ0Palette, obj_pixel_pairs[0]);
+}
+
+void PPU::WriteOBP1(u8 data)
+{
+    OBP1 = data;
+    DecodePalette(OBJ1Palette, data);
+    BuildPixelPairs(OBJ1Palette, obj_pixel_pairs[1]);
+}
+
+Color* PPU::GetLineColumn(u16& stride)
+{
+    if(headless)
+    {
+        stride = 1;
+        return headless_frames[framebuffer].data() + (LY * width);
     }
 
-    return return_code;
+    // The top screen is rotated, so a line is a column of it
+    u16 screenWidth;
+    u16 screenHeight;
+    Color* fb = (Color*) gfxGetFramebuffer(GFX_TOP, GFX_LEFT, &screenHeight, &screenWidth);
+    stride = screenHeight;
+    return fb + (height - LY + (screenWidth * 2));
 }
 
-void PPU::DrawScanline()
+void PPU::SignLine(LineSignature& signature)
 {
+    // Cleared first so padding and unused sprite slots compare equal
+    std::memset(&signature, 0, sizeof(signature));
+    signature.vram_generation = vram_generation;
+    signature.LCDC = LCDC;
+    signature.SCY = SCY;
+    signature.SCX = SCX;
+    signature.WY = WY;
+    signature.WX = WX;
+    signature.BGP = BGP;
+    signature.OBP0 = OBP0;
+    signature.OBP1 = OBP1;
+    signature.sprite_count = scanline_sprite_count;
+    for(int i = 0; i < scanline_sprite_count; i++)
+    {
+        int sprite = scanline_sprites[i];
+        signature.sprites[i][0] = sprites.y[sprite];
+        signature.sprites[i][1] = sprites.x[sprite];
+        signature.sprites[i][2] = sprites.id[sprite];
+        signature.sprites[i][3] = sprites.flags[sprite];
+    }
+}
+
+void PPU::DrawLine(const LineSignature& signature)
+{
+    // Skip lines that would come out just as they already are in
+    // both this frame's framebuffer and the back buffer
+    LineSignature& fb_signature = fb_signatures[framebuffer][LY];
+    if(line_skip &&
+       std::memcmp(&signature, &fb_signature, sizeof(signature)) == 0 &&
+       std::memcmp(&signature, &line_signatures[LY], sizeof(signature)) == 0)
+    {
+        frame_lines_skipped++;
+        stats.lines_skipped++;
+        if(verify_line_skip)
+            VerifyLine(signature);
+        return;
+    }
+
+    DrawScanline(signature);
+    fb_signature = signature;
+    line_signatures[LY] = signature;
+}
+
+void PPU::VerifyLine(const LineSignature& signature)
+{
+    // Draw the line anyway and check nothing changed
+    u16 stride;
+    const Color* column = GetLineColumn(stride);
+    const Color* line = back_buffer.data() + (LY * width);
+    std::vector<Color> before(width * 2);
     for(int x = 0; x < width; x++)
     {
-        int y = LY;
-
-        // Tile and pixel to draw
-        u8 tileY = y / 8;
-        u8 tileX = x / 8;
-        u8 pixelY = y % 8;
-        u8 pixelX = x % 8;
-        // Scroll offsets
-        u8 tileYoff = SCY / 8;
-        u8 tileXoff = SCX / 8;
-        u8 pixelYoff = SCY % 8;
-        u8 pixelXoff = SCX % 8;
-        // boundary between the scroll tiles
-        u8 upperHalf = (8 - pixelYoff);
-        u8 leftHalf = (8 - pixelXoff);
-        // tile to take from the BG map
-        u8 fetchY = tileY+tileYoff;
-        u8 fetchX = tileX+tileXoff;
-        if(pixelY >= upperHalf)
-        {
-            // start drawing from the top
-            // of the next tile down
-            fetchY++;
-            pixelY -= upperHalf;
-            pixelYoff = 0;
-        }
-        if(pixelX >= leftHalf)
+        before[x] = column[x * stride];
+        before[width + x] = line[x];
+    }
+
+    DrawScanline(signature);
+
+    for(int x = 0; x < width; x++)
+    {
+        if(column[x * stride] != before[x] || line[x] != before[width + x])
         {
-            fetchX++;
-            pixelX -= leftHalf;
-            pixelXoff = 0;
-        }
-        // wrap around
-        if(fetchY >= 32)
-            fetchY %= 32;
-        if(fetchX >= 32)
-            fetchX %= 32;
-        // fetch the tile to draw
-        u16 base = 0x9800;
-        if(LCDC & 0x08) {
-            base += 0x0400;
+            stats.skip_mismatches++;
+            gameboy->SystemError("Skipped line " + std::to_string(LY) + " draws differently");
+            return;
         }
-        u8 tileID = memory_bus->Read8(base + (fetchY * 32) + fetchX);
-        // Draw the pixel
-        int drawY = LY * width;
-        int drawX = x;
-
-        u16 screenWidth;
-        u16 screenHeight;
-        Color* fb = (Color*) gfxGetFramebuffer(GFX_TOP, GFX_LEFT, &screenHeight, &screenWidth);
-        fb[(x * screenHeight) + (height - LY + (screenWidth * 2))] = BGPalette[BGTileset[tileID].GetPixel(pixelX+pixelXoff, pixelY+pixelYoff)];
     }
+}
+
+void PPU::DrawPendingLines()
+{
+    if(pending_count == 0)
+        return;
+
+    // Each line is drawn with its own registers loaded, then
+    // they are put back the way the CPU has them now
+    u8 line = LY;
+    LineSignature current;
+    SignLine(current);
+    for(int i = 0; i < pending_count; i++)
+    {
+        LoadLineRegisters(pending_lines[i].LY, pending_lines[i].signature);
+        DecodeTiles();
+        DrawLine(pending_lines[i].signature);
+    }
+    LoadLineRegisters(line, current);
+    pending_count = 0;
+    stats.deferred_batches++;
+}
+
+void PPU::LoadLineRegisters(u8 line, const LineSignature& signature)
+{
+    LY = line;
+    LCDC = signature.LCDC;
+    SCY = signature.SCY;
+    SCX = signature.SCX;
+    WY = signature.WY;
+    WX = signature.WX;
+    // These rebuild their tables, so only when they differ
+    if(BGP != signature.BGP)
+        WriteBGP(signature.BGP);
+    if(OBP0 != signature.OBP0)
+        WriteOBP0(signature.OBP0);
+    if(OBP1 != signature.OBP1)
+        WriteOBP1(signature.OBP1);
+}
+
+void PPU::DrawScanline(const LineSignature& signature)
+{
+    // The line is a slice of the BG layer, wrapping around its edges
+    u8 bgY = LY + SCY;
+    const Color* layer = UpdateLayer(bg_layer, (LCDC & 0x08)? 0x9C00 : 0x9800, bgY / 8);
+    const Color* row = layer + (bgY * LAYER_SIZE);
+
+    u16 stride;
+    Color* column = GetLineColumn(stride);
+    for(int x = 0; x < width; x++)
+        column[x * stride] = row[(SCX + x) % LAYER_SIZE];
 
     if((LCDC & 0x20) && LY >= WY) {
         DrawScanlineWindow();
     }
     if(LCDC & 0x02) {
-        DrawScanlineSprites();
+        DrawScanlineSprites(signature);
     }
 }
 
@@ -210,135 +463,274 @@ void PPU::DrawScanlineWindow()
     // If the window is disabled partway down the screen,
     // it doesn't draw the last line of the window.
     // (window is disabled before window finishes drawing)
-    for(int x = WX; x < width + 7; x++)
-    {
-        int y = LY;
-        // Tile and pixel to draw
-        u8 tileY = (LY - WY) / 8;
-        u8 tileX = (x - WX) / 8;
-        u8 pixelY = (LY - WY) % 8;
-        u8 pixelX = (x - WX) % 8;
-        // fetch the tile to draw
-        u16 base = 0x9800;
-        if(LCDC & 0x40) {
-            base += 0x0400;
-        }
-        u8 tileID = memory_bus->Read8(base + (tileY * 32) + tileX);
-        // Draw the pixel
-        int drawY = y * width;
-        int drawX = x - 7;
-        if(drawX < 0)
-            continue;
-        
-        back_buffer[drawY + drawX] = BGPalette[BGTileset[tileID].GetPixel(pixelX, pixelY)];
-    }
+    u8 windowY = LY - WY;
+    const Color* layer = UpdateLayer(window_layer, (LCDC & 0x40)? 0x9C00 : 0x9800, windowY / 8);
+    const Color* row = layer + (windowY * LAYER_SIZE);
+    Color* line = back_buffer.data() + (LY * width);
+    // Window pixels land 7 to the left of WX
+    for(int drawX = std::max(WX - 7, 0); drawX < width; drawX++)
+        line[drawX] = row[drawX + 7 - WX];
 }
 
-void PPU::DrawScanlineSprites()
+void PPU::DrawScanlineSprites(const LineSignature& signature)
 {
     const int SPRITE_HEIGHT = (LCDC & 04)? 16 : 8;
 
-    for(auto it = ScanlineSprites.begin(); it != ScanlineSprites.end(); it++)
+    Color* line = back_buffer.data() + (LY * width);
+    for(int n = 0; n < signature.sprite_count; n++)
     {
-        Graphics::Sprite& sprite = *it;
+        const u8* sprite = signature.sprites[n];
         // offset by 16 to align with Sprite y
         int adjScanline = LY + 16;
-        int y = sprite._y;
-        int x = sprite._x;
-        const Color* palette = (sprite.palette == 0)? OBJ0Palette : OBJ1Palette;
-        for(int px = 0; px < 8; px++)
+        int y = sprite[0];
+        int x = sprite[1];
+        u8 flags = sprite[3];
+        bool flipX = (flags & 0x20) != 0;
+        bool flipY = (flags & 0x40) != 0;
+        // flip sprites; tall sprites carry on into the next tile
+        int oamY = (flipY)? ((SPRITE_HEIGHT - 1) - (adjScanline - y)) : (adjScanline - y);
+        u16 bits = tiles[sprite[2] + (oamY / 8)].rows[oamY % 8];
+
+        // Expand the row a pixel pair at a time, mirrored pairs
+        // taken from the other end of it if flipped
+        const Graphics::PixelPair* pairs = obj_pixel_pairs[(flags >> 4) & 0x01][flipX];
+        Color colors[8];
+        Color masks[8];
+        for(int i = 0; i < 4; i++)
         {
-            // don't draw the x pixels if they are offscreen
-            if(x+px < 8 || x+px >= 168)
-                continue;
-            // flip sprites
-            int oamX = (sprite.flipX)? (7 - px) : px;
-            int oamY = (sprite.flipY)? ((SPRITE_HEIGHT - 1) - (adjScanline - y)) : (adjScanline - y);
-            u8 color = OBJTileset[sprite.id].GetPixel(oamX, oamY);
-            // 00 is transparent for sprites: use the color of the background instead
-            if(color == 0x00)
-                continue;
-            int drawY = LY * width;
-            int drawX = (x - 8) + px;
-            back_buffer[drawY + drawX] = palette[color];
+            int shift = (flipX)? (i * 4) : (12 - (i * 4));
+            const Graphics::PixelPair& pair = pairs[(bits >> shift) & 0x0F];
+            colors[i*2] = pair.color[0];
+            colors[(i*2)+1] = pair.color[1];
+            masks[i*2] = pair.mask[0];
+            masks[(i*2)+1] = pair.mask[1];
         }
+
+        // Blend over the line where it is on screen; the
+        // transparent pixels keep the color under them
+        int first = (x < 8)? (8 - x) : 0;
+        int last = (x > 160)? (168 - x) : 8;
+        Color* draw = line + (x - 8);
+        for(int px = first; px < last; px++)
+            draw[px] = (draw[px] & ~masks[px]) | (colors[px] & masks[px]);
     }
-    ScanlineSprites.clear();
 }
 
 void PPU::FetchScanlineSprites()
 {
-    const int OAM_SIZE = 4;
-    const int OAM_COUNT = 40;
     const int SPRITE_HEIGHT = (LCDC & 04)? 16 : 8;
 
-    int spriteCounter = 0;
-    for(int i = 0; i < OAM_COUNT; i++)
+    // OAM is only looked at again once it has been written; only
+    // this is timed, picking a line's sprites is just two loads
+    if(sprites_dirty || line_sprites_height != SPRITE_HEIGHT)
     {
-        Graphics::Sprite sprite;
-        u8 buffer[4];
-        memory_bus->ReadBytes(buffer, 0xFE00 + (i * OAM_SIZE), OAM_SIZE);
-        sprite.Decode(buffer);
-        // offset by 16 to align with Sprite y
-        u8 adjScanline = LY + 16;
-        u8 y = sprite._y;
-        u8 x = sprite._x;
+        auto start = std::chrono::steady_clock::now();
+        if(sprites_dirty)
+        {
+            u8 buffer[Graphics::SpriteTable::COUNT * 4];
+            memory_bus->ReadBytes(buffer, 0xFE00, sizeof(buffer));
+            sprites.Decode(buffer);
+            sprites_dirty = false;
+        }
+        IndexSprites(SPRITE_HEIGHT);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        frame_sprite_eval_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    scanline_sprites = line_sprites[LY];
+    scanline_sprite_count = line_sprite_counts[LY];
+}
+
+void PPU::IndexSprites(int height)
+{
+    std::fill(line_sprite_counts, line_sprite_counts + LINES, 0);
+    for(int i = 0; i < Graphics::SpriteTable::COUNT; i++)
+    {
+        int y = sprites.y[i];
+        int x = sprites.x[i];
         // if the sprite is offscreen
         // sprites start at (8, 16) so you can scroll them in
         if((y == 0 || y >= 160) || (x == 0 || x >= 168))
             continue;
-        // if the sprite is not within range of this scanline
-        if(adjScanline < y || (adjScanline - y) >= SPRITE_HEIGHT)
-            continue;
-        // only 10 sprites per scanline
-        if(++spriteCounter > 10)
-            return;
+        // lines it covers, offset by 16 to align with Sprite y
+        int first = std::max(y - 16, 0);
+        int last = std::min(y - 16 + height, LINES);
+        for(int line = first; line < last; line++)
+        {
+            // only 10 sprites per scanline
+            if(line_sprite_counts[line] < LINE_SPRITES)
+                line_sprites[line][line_sprite_counts[line]++] = i;
+        }
+    }
+    line_sprites_height = height;
+    stats.sprite_indexes++;
+}
+
+void PPU::MarkSpritesDirty(void* ppu, u16 address)
+{
+    static_cast<PPU*>(ppu)->sprites_dirty = true;
+}
+
+void PPU::MarkTileDirty(void* ppu, u16 address)
+{
+    PPU* self = static_cast<PPU*>(ppu);
+    self->DrawEarly();
+    self->vram_generation++;
+    int tile = (address - 0x8000) / 16;
+    self->dirty_tiles[tile / 32] |= 1u << (tile % 32);
+    self->tiles_dirty = true;
+}
 
-        ScanlineSprites.push_back(sprite);
+void PPU::DrawEarly()
+{
+    // Deferred lines have to be drawn from VRAM as it was
+    if(pending_count != 0)
+    {
+        stats.early_batches++;
+        DrawPendingLines();
     }
 }
 
 void PPU::DecodeTiles()
 {
-    // fetch each tile in the tileset from VRAM
-    // and decode their 2-bit colors
-    const int BG_SIZE = 16;
-    const int OBJ_SIZE = 16;
+    // Only tiles written since the last line need decoding again;
+    // LCDC bit 4 just changes which of them the BG uses
+    if(!tiles_dirty)
+        return;
 
-    // Background Tileset
-    for(int bg = 0; bg < 256; bg++)
+    const int TILE_SIZE = 16;
+    u32 decoded[TILE_COUNT / 32];
+    for(int word = 0; word < TILE_COUNT / 32; word++)
     {
-        // if LCDC bit 4 == 0,
-        // BG tiles 00-7F start at 0x9000
-        // and 80-FF start at 0x8800
-        // Otherwise, BG tiles align with
-        // OBJ tiles at 0x8000
-        u16 base = 0x8000;
-        u8 rawTile = bg;
-        if((LCDC & 0x10) == 0)
+        u32 dirty = dirty_tiles[word];
+        decoded[word] = dirty;
+        dirty_tiles[word] = 0;
+        for(int bit = 0; dirty != 0; bit++, dirty >>= 1)
         {
-            if(bg >= 128)
-            {
-                base = 0x8800;
-                // start fetching from 0x8800,
-                // not 0x8800 + 128 tiles
-                rawTile -= 128;
-            }
-            else
-                base = 0x9000;
+            if((dirty & 1) == 0)
+                continue;
+            int tile = (word * 32) + bit;
+            u8 buffer[TILE_SIZE];
+            memory_bus->ReadBytes(buffer, 0x8000 + (tile * TILE_SIZE), TILE_SIZE);
+            tiles[tile].Decode(buffer);
+            frame_tiles_decoded++;
+            stats.tiles_decoded++;
+        }
+    }
+    tiles_dirty = false;
+
+    // Redraw wherever the layers use the new tiles
+    MarkLayerTiles(bg_layer, decoded);
+    MarkLayerTiles(window_layer, decoded);
+}
+
+void PPU::MarkMapDirty(void* ppu, u16 address)
+{
+    PPU* self = static_cast<PPU*>(ppu);
+    self->DrawEarly();
+    self->vram_generation++;
+    u16 map = address & 0xFC00;
+    int entry = address & 0x03FF;
+    MapIndex& index = self->map_indexes[(map >> 10) & 1];
+    index.written[entry / 32] |= 1u << (entry % 32);
+    index.stale = true;
+    Layer* layers[2] = { &self->bg_layer, &self->window_layer };
+    for(Layer* layer : layers)
+    {
+        if(layer->map == map)
+            layer->dirty[entry / 32] |= 1u << (entry % 32);
+    }
+}
+
+void PPU::InvalidateLayer(Layer& layer)
+{
+    std::fill(layer.dirty, layer.dirty + 32, 0xFFFFFFFF);
+    stats.layer_invalidations++;
+}
+
+void PPU::MarkLayerTiles(Layer& layer, const u32* decoded)
+{
+    if(layer.map == 0)
+        return;
+
+    MapIndex& index = map_indexes[(layer.map >> 10) & 1];
+    IndexMap(index, layer.map);
+    for(int word = 0; word < TILE_COUNT / 32; word++)
+    {
+        u32 bits = decoded[word];
+        for(int bit = 0; bits != 0; bit++, bits >>= 1)
+        {
+            if((bits & 1) == 0)
+                continue;
+            // BG ids reach tiles 0-255, or 128-383 if LCDC bit 4 is clear,
+            // so either way a tile's id is its low byte
+            int tile = (word * 32) + bit;
+            if((layer.tile_select)? tile >= 256 : tile < 128)
+                continue;
+            const u32* entries = index.entries[tile & 0xFF];
+            for(int row = 0; row < 32; row++)
+                layer.dirty[row] |= entries[row];
         }
+    }
+}
+
+void PPU::IndexMap(MapIndex& index, u16 map)
+{
+    if(!index.stale)
+        return;
 
-        u8 buffer[BG_SIZE];
-        memory_bus->ReadBytes(buffer, base + (rawTile * BG_SIZE), BG_SIZE);
-        BGTileset.at(bg).Decode(buffer);
+    for(int row = 0; row < 32; row++)
+    {
+        u32 written = index.written[row];
+        if(written == 0)
+            continue;
+        index.written[row] = 0;
+        u8 ids[32];
+        memory_bus->ReadBytes(ids, map + (row * 32), sizeof(ids));
+        for(int column = 0; written != 0; column++, written >>= 1)
+        {
+            if((written & 1) == 0)
+                continue;
+            u8& id = index.ids[(row * 32) + column];
+            index.entries[id][row] &= ~(1u << column);
+            id = ids[column];
+            index.entries[id][row] |= 1u << column;
+        }
     }
-    // Sprite tileset
-    for(int obj = 0; obj < 256; obj++)
+    index.stale = false;
+}
+
+const Color* PPU::UpdateLayer(Layer& layer, u16 map, int tileY)
+{
+    // Switching tile map, tile data or palette throws the whole
+    // layer away; the palette only once a line is drawn under it
+    u8 tile_select = LCDC & 0x10;
+    if(layer.map != map || layer.tile_select != tile_select || layer.palette != BGP)
     {
-        u8 buffer[OBJ_SIZE];
-        memory_bus->ReadBytes(buffer, 0x8000 + (obj * OBJ_SIZE), OBJ_SIZE);
-        OBJTileset.at(obj).Decode(buffer);
+        layer.map = map;
+        layer.tile_select = tile_select;
+        layer.palette = BGP;
+        InvalidateLayer(layer);
+    }
+
+    u32 dirty = layer.dirty[tileY];
+    if(dirty == 0)
+        return layer.pixels.data();
+    layer.dirty[tileY] = 0;
+
+    u8 ids[32];
+    memory_bus->ReadBytes(ids, map + (tileY * 32), sizeof(ids));
+    for(int tileX = 0; dirty != 0; tileX++, dirty >>= 1)
+    {
+        if((dirty & 1) == 0)
+            continue;
+        const Graphics::Tile& tile = GetBGTile(ids[tileX]);
+        Color* out = layer.pixels.data() + (tileY * 8 * LAYER_SIZE) + (tileX * 8);
+        for(int row = 0; row < 8; row++, out += LAYER_SIZE)
+            Graphics::ExpandRow(tile.rows[row], bg_row_colors, out);
+        stats.layer_tiles_drawn++;
     }
+    return layer.pixels.data();
 }
 
 }; // namespace Core
@@ -19,32 +19,53 @@
 #include <vector>
 #include <memory>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 namespace Memory {
     class MemoryBus;
 }; // namespace Memory
 
 namespace Graphics {
+    // Each 8-bit value with its bits spread out to every other bit
+    extern const u16 BIT_SPREAD[256];
+
     struct Tile
     {
         // pixels are stored every two bits
         // 16 bits per row for 8 rows
         u16 rows[8];
 
-        inline void Decode(const u8* src)
+        inline void DecodeTable(const u8* src)
         {
-            // interleave the bits
+            // interleave the bits; the low bitplane
+            // lands on even bits, the high one on odd
             for(int row = 0; row < 8; row++)
-            {
-                u32 upper = static_cast<u32>(src[(row*2)+1]) << 16;
-                u32 lower = static_cast<u32>(src[row*2]);
-                u32 morton = upper | lower;
-                morton = (morton ^ (morton << 4)) & 0x0F0F0F0F; // separate nybbles
-                morton = (morton ^ (morton << 2)) & 0x33333333; // separate half-nybbles
-                morton = (morton ^ (morton << 1)) & 0x55555555; // separate bits
-                rows[row] = static_cast<u16>(morton | (morton >> 15));
-            }
+                rows[row] = BIT_SPREAD[src[row*2]] | (BIT_SPREAD[src[(row*2)+1]] << 1);
+        }
+#if defined(__SSE2__)
+        // All 8 rows at once, one per 16-bit lane
+        inline void Decode(const u8* src)
+        {
+            __m128i planes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            __m128i low = _mm_and_si128(planes, _mm_set1_epi16(0x00FF));
+            __m128i high = _mm_srli_epi16(planes, 8);
+            low = Spread(low);
+            high = Spread(high);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rows), _mm_or_si128(low, _mm_slli_epi16(high, 1)));
+        }
+        static inline __m128i Spread(__m128i x)
+        {
+            x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 4)), _mm_set1_epi16(0x0F0F));
+            x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 2)), _mm_set1_epi16(0x3333));
+            return _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 1)), _mm_set1_epi16(0x5555));
         }
+#else
+        inline void Decode(const u8* src)
+            { DecodeTable(src); }
+#endif
 
         inline const u8 GetPixel(u8 x, u8 y)
         {
@@ -56,45 +77,105 @@ namespace Graphics {
         }
     };
 
-    struct Sprite
+    // Colors of the 8 pixels in a decoded tile row, given
+    // the colors of every 4-pixel half row under a palette
+    inline void ExpandRow(u16 row, const Color (*halves)[4], Color* out)
     {
-        u8 _y;
-        u8 _x;
-        u8 id;
-        u8 priority;
-        bool flipY;
-        bool flipX;
-        u8 palette;
+        const Color* left = halves[row >> 8];
+        const Color* right = halves[row & 0xFF];
+#if defined(__SSE2__)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_loadu_si128(reinterpret_cast<const __m128i*>(left)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_loadu_si128(reinterpret_cast<const __m128i*>(right)));
+#else
+        out[0] = left[0];
+        out[1] = left[1];
+        out[2] = left[2];
+        out[3] = left[3];
+        out[4] = right[0];
+        out[5] = right[1];
+        out[6] = right[2];
+        out[7] = right[3];
+#endif
+    }
+
+    // Colors of two sprite pixels and masks of which are opaque,
+    // ready to blend over what is already drawn
+    struct PixelPair
+    {
+        Color color[2];
+        Color mask[2];
+    };
+
+    // OAM decoded into one array per attribute
+    struct SpriteTable
+    {
+        static const int COUNT = 40;
+        u8 y[COUNT];
+        u8 x[COUNT];
+        u8 id[COUNT];
+        // priority, flipY, flipX and palette in bits 7-4
+        u8 flags[COUNT];
 
         inline void Decode(const u8* src)
         {
-            _y = src[0];
-            _x = src[1];
-            id = src[2];
-            priority = (src[3] & 0b10000000) >> 7;
-            flipY = (src[3] & 0b01000000) != 0;
-            flipX = (src[3] & 0b00100000) != 0;
-            palette = (src[3] & 0b00010000) >> 4;
+            for(int i = 0; i < COUNT; i++)
+            {
+                y[i] = src[i*4];
+                x[i] = src[(i*4)+1];
+                id[i] = src[(i*4)+2];
+                flags[i] = src[(i*4)+3];
+            }
         }
     };
 }; // namespace Graphics
 
 namespace Core {
 class GameBoy;
+class Scheduler;
 
 class PPU
 {
-    friend class Memory::MemoryBus;
+public:
+    struct Stats
+    {
+        // Tiles re-decoded in all and during the last frame
+        u64 tiles_decoded = 0;
+        u32 frame_tiles_decoded = 0;
+        // Times the sprite line index was rebuilt, and the
+        // time spent rebuilding it during the last frame
+        u32 sprite_indexes = 0;
+        u64 frame_sprite_eval_ns = 0;
+        // BG/window layers thrown away whole on an LCDC or BGP
+        // change, and tiles redrawn into them for any reason
+        u32 layer_invalidations = 0;
+        u64 layer_tiles_drawn = 0;
+        // Lines left as they were in all and during the last frame,
+        // and lines the verify mode found drawn differently anyway
+        u64 lines_skipped = 0;
+        u32 frame_lines_skipped = 0;
+        u32 skip_mismatches = 0;
+        // Batches of deferred lines drawn, and those drawn early
+        // because VRAM was about to change under them
+        u32 deferred_batches = 0;
+        u32 early_batches = 0;
+
+        // Share of the last frame's lines that were skipped
+        float SkipRate() const
+            { return frame_lines_skipped / 144.0f; }
+    };
+
+private:
     // IO Registers
     // LCD controller
     u8 LCDC;
     // LCD Status
     u8 STAT;
-    u8 SCY, SCX;
+    u8 SCY = 0, SCX = 0;
     u8 LY;
     // Acts as a breakpoint
-    u8 LYC;
-    // Palettes
+    u8 LYC = 0;
+    // Palettes, as written and as colors
+    u8 BGP = 0x00, OBP0 = 0x00, OBP1 = 0x00;
     Color BGPalette[4];
     Color OBJ0Palette[4];
     Color OBJ1Palette[4];
@@ -103,34 +184,167 @@ class PPU
 
     // Back buffer the ppu draws to
     std::vector<Color> back_buffer;
-    // Spritesheets
-    std::vector<Graphics::Tile> BGTileset;
-    std::vector<Graphics::Tile> OBJTileset;
-    // Sprites to draw
-    std::vector<Graphics::Sprite> ScanlineSprites;
+    // Colors of each 4-pixel half of a tile row under BGP
+    Color bg_row_colors[256][4];
+    // Each nibble (2 pixels) of a sprite row under OBP0/OBP1,
+    // as is and mirrored for X-flipped sprites
+    Graphics::PixelPair obj_pixel_pairs[2][2][16];
+    // Every tile in VRAM, 0x8000-0x97FF, decoded; OBJ tiles are
+    // 0-255 and BG tiles either the same or 128-383 per LCDC bit 4
+    static const int TILE_COUNT = 384;
+    std::vector<Graphics::Tile> tiles;
+    // A bit per tile written since it was last decoded
+    u32 dirty_tiles[TILE_COUNT / 32];
+    bool tiles_dirty = false;
+    u32 frame_tiles_decoded = 0;
+    static void MarkTileDirty(void* ppu, u16 address);
+
+    Graphics::Tile& GetBGTile(u8 id)
+        { return (LCDC & 0x10)? tiles[id] : tiles[256 + static_cast<s8>(id)]; }
+
+    // A whole 256x256 tile map drawn out under BGP, redrawn a
+    // tile at a time as VRAM writes leave parts of it stale
+    static const int LAYER_SIZE = 256;
+    struct Layer
+    {
+        std::vector<Color> pixels;
+        // A bit per tile, a word per row of tiles
+        u32 dirty[32];
+        // Tile map, LCDC bit 4 and BGP it was drawn with; map is 0
+        // until first used
+        u16 map = 0;
+        u8 tile_select = 0;
+        u8 palette = 0;
+    };
+    Layer bg_layer;
+    Layer window_layer;
+    // For each tile map, a bit per entry holding each tile id, so
+    // new tiles only mark the entries that show them; entries move
+    // to their new id once written, when next needed
+    struct MapIndex
+    {
+        u32 entries[256][32];
+        u8 ids[32 * 32];
+        // Entries written since they were indexed
+        u32 written[32];
+        bool stale;
+    };
+    MapIndex map_indexes[2];
+    void IndexMap(MapIndex& index, u16 map);
+    static void MarkMapDirty(void* ppu, u16 address);
+    void InvalidateLayer(Layer& layer);
+    void MarkLayerTiles(Layer& layer, const u32* decoded);
+    // Brings a row of tiles up to date and returns the pixels
+    const Color* UpdateLayer(Layer& layer, u16 map, int tileY);
+    // OAM as of the last OAM scan after it was written
+    Graphics::SpriteTable sprites;
+    bool sprites_dirty = true;
+    static void MarkSpritesDirty(void* ppu, u16 address);
+    // Sprites on each line, in OAM order, rebuilt whenever
+    // OAM or the sprite size changes
+    static const int LINES = 144;
+    static const int LINE_SPRITES = 10;
+    u8 line_sprites[LINES][LINE_SPRITES];
+    u8 line_sprite_counts[LINES];
+    int line_sprites_height = 0;
+    void IndexSprites(int height);
+    // Sprites to draw, picked during the OAM scan
+    const u8* scanline_sprites = nullptr;
+    int scanline_sprite_count = 0;
+    u64 frame_sprite_eval_ns = 0;
+
+    // Everything a line's pixels depend on; drawing a line with the
+    // same signature as last time would leave it exactly as it was
+    struct LineSignature
+    {
+        u32 vram_generation;
+        u8 LCDC, SCY, SCX, WY, WX;
+        u8 BGP, OBP0, OBP1;
+        u8 sprite_count;
+        u8 sprites[LINE_SPRITES][4];
+    };
+    // Bumped on every VRAM write
+    u32 vram_generation = 1;
+    // What each line of both framebuffers and the back
+    // buffer was last drawn with
+    LineSignature fb_signatures[2][LINES];
+    LineSignature line_signatures[LINES];
+    // Framebuffer being drawn to; they swap every frame
+    int framebuffer = 0;
+    // Headless systems draw to these instead of the top screen
+    bool headless;
+    std::vector<Color> headless_frames[2];
+    bool line_skip;
+    bool verify_line_skip;
+    u32 frame_lines_skipped = 0;
+    void SignLine(LineSignature& signature);
+    void DrawLine(const LineSignature& signature);
+    void VerifyLine(const LineSignature& signature);
+    // Sprites come from the signature, as OAM stood for the line
+    void DrawScanline(const LineSignature& signature);
+    void DrawScanlineSprites(const LineSignature& signature);
+    // Where this line goes on the top screen, a pixel every 'stride'
+    Color* GetLineColumn(u16& stride);
+
+    // Lines waiting to be drawn at V-Blank when rendering is
+    // deferred; the signature holds every register and sprite a
+    // line is drawn from, so VRAM is all that has to stay put
+    struct PendingLine
+    {
+        u8 LY;
+        LineSignature signature;
+    };
+    bool deferred_render;
+    PendingLine pending_lines[LINES];
+    int pending_count = 0;
+    void DrawPendingLines();
+    // Called just before VRAM is written
+    void DrawEarly();
+    void LoadLineRegisters(u8 line, const LineSignature& signature);
 
     // Window size
     int width;
     int height;
 
-    // cycle counter per frame
-    int frameCycles;
+    // frames drawn so far; bumped on entering V-Blank
+    u32 frameCount = 0;
+    Stats stats;
 
     // system pointers
     GameBoy* gameboy;
     std::shared_ptr<Memory::MemoryBus> memory_bus;
+    Scheduler& scheduler;
+
+    // Length of each mode; a line is 456 cycles
+    static const int OAM_CYCLES = 80;
+    static const int TRANSFER_CYCLES = 172;
+    static const int HBLANK_CYCLES = 204;
+    static const int LINE_CYCLES = 456;
+
+    void CompareLY();
+    void WriteLY(u8 data);
+    void WriteBGP(u8 data);
+    void WriteOBP0(u8 data);
+    void WriteOBP1(u8 data);
 
 public:
     PPU(GameBoy* gameboy, int width, int height,
-        std::shared_ptr<Memory::MemoryBus>& memory_bus);
+        std::shared_ptr<Memory::MemoryBus>& memory_bus,
+        Scheduler& scheduler);
 
-    int Update(int cycles);
+    // Handles the end of the current mode; called by
+    // the scheduler, 'late' cycles after it was due
+    void Update(u64 late);
+    void WriteLCDC(u8 data);
+    void WriteSTAT(u8 data);
+    u32 GetFrameCount()
+        { return frameCount; }
+    Stats& GetStats()
+        { return stats; }
 
     std::vector<Color>& GetBackBuffer();
 
-    void DrawScanline();
     void DrawScanlineWindow();
-    void DrawScanlineSprites();
     void FetchScanlineSprites();
     void DecodeTiles();
 };
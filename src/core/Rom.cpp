@@ -18,25 +18,28 @@
 
 #include <string>
 #include <algorithm>
+#include <utility>
 
 
 namespace Core {
 
-Rom::Rom(const std::vector<u8>& bytes, int force_mbc)
+Rom::Rom(std::unique_ptr<RomImage> rom_image, int force_mbc)
 :
-    bytes (bytes)
+    image (std::move(rom_image))
 {
+    const u8* bytes = image->GetBank(0);
+
     // copy the rom name (in newer carts the end of this is used by manufacturer code)
-    std::copy(bytes.begin() + 0x134, bytes.begin() + 0x143, header.Name);
+    std::copy(bytes + 0x134, bytes + 0x143, header.Name);
     LOG_MSG("Loaded rom: " + std::string(header.Name));
     // copy the new manufacturer code
-    std::copy(bytes.begin() + 0x13F, bytes.begin() + 0x143, header.Manufacturer);
-    header.UsesSGBFeatures = bytes.at(0x146) == 0x03; // 3 means yes, 0 means no
-    header.RomSize = bytes.at(0x148);
-    header.RamSize = bytes.at(0x149);
-    header.International = bytes.at(0x14A) == 0x01; // 00 means Japan, 01 means international
-    header.Licensee = bytes.at(0x14B); // if 33, SGB functions don't work
-    header.VersionCode = bytes.at(0x14C); // usually 00
+    std::copy(bytes + 0x13F, bytes + 0x143, header.Manufacturer);
+    header.UsesSGBFeatures = bytes[0x146] == 0x03; // 3 means yes, 0 means no
+    header.RomSize = bytes[0x148];
+    header.RamSize = bytes[0x149];
+    header.International = bytes[0x14A] == 0x01; // 00 means Japan, 01 means international
+    header.Licensee = bytes[0x14B]; // if 33, SGB functions don't work
+    header.VersionCode = bytes[0x14C]; // usually 00
 
     // Cart Type specifies which MBC type is used in the cart,
     // and what external hardware (i.e. battery) is included.
@@ -57,7 +60,7 @@ Rom::Rom(const std::vector<u8>& bytes, int force_mbc)
     //     11 - MBC3                            FD - BANDAI TAMA5
     //     12 - MBC3 + RAM                      FE - HuC3
     //     13 - MBC3 + RAM + BATTERY            FF - HuC1 + RAM + BATTERY
-    header.CartType = (force_mbc == -1)? bytes.at(0x147) : force_mbc;
+    header.CartType = (force_mbc == -1)? bytes[0x147] : force_mbc;
     //LOG_MSG("Cart type " + header.CartType);
 }
 
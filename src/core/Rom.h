@@ -14,9 +14,11 @@
 
 #pragma once
 
+#include "RomImage.h"
+
 #include "../common/Types.h"
 
-#include <vector>
+#include <memory>
 
 
 namespace Core {
@@ -39,13 +41,14 @@ class Rom
     };
     Header header;
     // all bytes in the ROM
-    std::vector<u8> bytes;
+    std::unique_ptr<RomImage> image;
 
 public:
-    Rom(const std::vector<u8>& bytes, int force_mbc);
+    // The MBCs map banks straight out of the image
+    Rom(std::unique_ptr<RomImage> image, int force_mbc);
 
-    std::vector<u8>& GetBytes()
-        { return bytes; }
+    RomImage* GetImage()
+        { return image.get(); }
 
     char* GetRomName()
         { return header.Name; }
@@ -0,0 +1,268 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "RomImage.h"
+#include "LZ4.h"
+
+#include "../debug/Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// The 3DS has no mmap, so it always reads the file in
+#ifndef _3DS
+#define ROM_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace Core {
+
+const u32 RomImage::BANK_SIZE;
+const u32 RomImage::Slot::EMPTY;
+
+RomImage::RomImage(std::vector<u8> bytes)
+:
+    bytes (std::move(bytes))
+{
+    Pad();
+}
+
+RomImage::~RomImage()
+{
+#ifdef ROM_USE_MMAP
+    if(mapping != nullptr)
+        munmap(mapping, banks * BANK_SIZE);
+#endif
+    if(file != nullptr)
+        std::fclose(file);
+}
+
+std::unique_ptr<RomImage> RomImage::Open(const std::string& path)
+{
+    std::unique_ptr<RomImage> image (new RomImage());
+
+#ifdef ROM_USE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return nullptr;
+    struct stat st;
+    // Only map images that are already whole banks, anything
+    // else needs padding and takes the read path below
+    if(fstat(fd, &st) == 0 && st.st_size >= 2 * BANK_SIZE && (st.st_size % BANK_SIZE) == 0)
+    {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED)
+        {
+            close(fd);
+            image->mapping = mapping;
+            image->data = static_cast<const u8*>(mapping);
+            image->banks = static_cast<u32>(st.st_size / BANK_SIZE);
+            return image;
+        }
+    }
+    close(fd);
+#endif
+
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(file == nullptr)
+        return nullptr;
+    std::fseek(file, 0, SEEK_END);
+    long length = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if(length > 0)
+    {
+        image->bytes.resize(length);
+        image->bytes.resize(std::fread(image->bytes.data(), 1, length, file));
+    }
+    std::fclose(file);
+
+    image->Pad();
+    return image;
+}
+
+std::unique_ptr<RomImage> RomImage::OpenPaged(const std::string& path, int pool_banks)
+{
+    std::unique_ptr<RomImage> image (new RomImage());
+
+    image->file = std::fopen(path.c_str(), "rb");
+    if(image->file == nullptr)
+        return nullptr;
+    std::fseek(image->file, 0, SEEK_END);
+    long length = std::ftell(image->file);
+    image->banks = std::max<u32>(2, (length + BANK_SIZE - 1) / BANK_SIZE);
+
+    // Bank 0 is always resident
+    image->bytes.assign(BANK_SIZE, 0xFF);
+    std::fseek(image->file, 0, SEEK_SET);
+    std::fread(image->bytes.data(), 1, BANK_SIZE, image->file);
+    image->data = image->bytes.data();
+
+    image->InitPool(pool_banks);
+    return image;
+}
+
+std::unique_ptr<RomImage> RomImage::OpenCompressed(const std::string& path, int pool_banks)
+{
+    std::unique_ptr<RomImage> whole = Open(path);
+    if(!whole)
+        return nullptr;
+
+    std::unique_ptr<RomImage> image (new RomImage());
+    image->banks = whole->GetBanks();
+    image->bytes.assign(whole->GetBank(0), whole->GetBank(0) + BANK_SIZE);
+    image->data = image->bytes.data();
+
+    // Bank 0 stays as it is; everything else is packed, and
+    // checked to unpack to what it was
+    image->compressed.resize(image->banks);
+    std::vector<u8> unpacked(BANK_SIZE);
+    for(u32 bank = 1; bank < image->banks; bank++)
+    {
+        image->compressed[bank] = LZ4::Compress(whole->GetBank(bank), BANK_SIZE);
+        image->compressed[bank].shrink_to_fit();
+        const std::vector<u8>& packed = image->compressed[bank];
+        if(!LZ4::Decompress(packed.data(), packed.size(), unpacked.data(), BANK_SIZE) ||
+           std::memcmp(unpacked.data(), whole->GetBank(bank), BANK_SIZE) != 0)
+        {
+            LOG_ERROR("ROM bank " + std::to_string(bank) + " doesn't survive compression");
+            return nullptr;
+        }
+        image->stats.raw_bytes += BANK_SIZE;
+        image->stats.stored_bytes += image->compressed[bank].size();
+    }
+
+    image->InitPool(pool_banks);
+    return image;
+}
+
+void RomImage::InitPool(int pool_banks)
+{
+    // Room for the mapped bank plus at least one more to prefetch into
+    pool.resize(std::max(2, pool_banks));
+    for(Slot& slot : pool)
+        slot.data.resize(BANK_SIZE);
+    resident.assign(banks, -1);
+    successor.assign(banks, Slot::EMPTY);
+    paged = true;
+
+    Map(1);
+}
+
+void RomImage::Pad()
+{
+    size_t padded = (bytes.size() + BANK_SIZE - 1) / BANK_SIZE * BANK_SIZE;
+    bytes.resize(std::max<size_t>(padded, 2 * BANK_SIZE), 0xFF);
+    data = bytes.data();
+    banks = static_cast<u32>(bytes.size() / BANK_SIZE);
+}
+
+const u8* RomImage::Load(u32 bank, bool prefetch)
+{
+    if(bank == 0)
+        return data;
+
+    clock++;
+    int index = resident[bank];
+    if(index >= 0)
+    {
+        Slot& slot = pool[index];
+        if(slot.prefetched && !prefetch)
+        {
+            slot.prefetched = false;
+            stats.prefetch_hits++;
+        }
+        slot.last_used = clock;
+        return slot.data.data();
+    }
+
+    // Take an empty slot, or evict the least recently
+    // used bank other than the one that's mapped in
+    index = -1;
+    for(int i = 0; i < static_cast<int>(pool.size()); i++)
+    {
+        if(pool[i].bank == Slot::EMPTY)
+        {
+            index = i;
+            break;
+        }
+        if(pool[i].bank == mapped_bank)
+            continue;
+        if(index < 0 || pool[i].last_used < pool[index].last_used)
+            index = i;
+    }
+    Slot& slot = pool[index];
+    if(slot.bank != Slot::EMPTY)
+    {
+        resident[slot.bank] = -1;
+        stats.evictions++;
+    }
+
+    if(prefetch)
+        stats.prefetches++;
+    else
+        stats.faults++;
+    if(file != nullptr)
+    {
+        std::fill(slot.data.begin(), slot.data.end(), 0xFF);
+        std::fseek(file, static_cast<long>(bank) * BANK_SIZE, SEEK_SET);
+        std::fread(slot.data.data(), 1, BANK_SIZE, file);
+    }
+    else
+    {
+        auto start = std::chrono::steady_clock::now();
+        const std::vector<u8>& packed = compressed[bank];
+        if(!LZ4::Decompress(packed.data(), packed.size(), slot.data.data(), BANK_SIZE))
+        {
+            // Don't leave whatever the slot held before mapped as ROM
+            LOG_ERROR("ROM bank " + std::to_string(bank) + " failed to decompress");
+            std::fill(slot.data.begin(), slot.data.end(), 0xFF);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        stats.decompressions++;
+        stats.decompress_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    slot.bank = bank;
+    slot.last_used = clock;
+    slot.prefetched = prefetch;
+    resident[bank] = index;
+    return slot.data.data();
+}
+
+const u8* RomImage::Map(u32 bank)
+{
+    // Remember where code went from the old bank, so the
+    // next time it's mapped its likely successor can be read
+    if(bank != mapped_bank)
+        successor[mapped_bank] = bank;
+    mapped_bank = bank;
+    const u8* mapped = Load(bank, false);
+
+    // Reading ahead happens here, at switch time, rather than on
+    // the next switch; it never evicts the bank just mapped
+    u32 next = successor[bank];
+    if(next != Slot::EMPTY && next != 0 && next != bank && resident[next] < 0)
+        Load(next, true);
+
+    return mapped;
+}
+
+}; // namespace Core
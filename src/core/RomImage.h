@@ -0,0 +1,130 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../common/Types.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Core {
+
+// The raw cartridge image; mapped straight from its file where
+// the platform has mmap, otherwise read into memory once. In paged
+// mode only bank 0 and a small pool of recently used banks are kept
+// in memory, and the rest are read from the file when needed, or
+// from LZ4-compressed copies held in memory in compressed mode
+class RomImage
+{
+public:
+    static const u32 BANK_SIZE = 0x4000;
+
+    struct Stats
+    {
+        // Banks that had to be read in when asked for
+        u32 faults = 0;
+        // Banks dropped from the pool to make room
+        u32 evictions = 0;
+        // Banks read in ahead of time, and how many were then used
+        u32 prefetches = 0;
+        u32 prefetch_hits = 0;
+        // Compressed mode: size of the switchable banks before and
+        // after compression, and time spent unpacking them
+        u32 raw_bytes = 0;
+        u32 stored_bytes = 0;
+        u32 decompressions = 0;
+        u64 decompress_ns = 0;
+
+        float CompressionRatio() const
+            { return (stored_bytes > 0)? static_cast<float>(raw_bytes) / stored_bytes : 0.0f; }
+        // Average microseconds to unpack a bank
+        float DecompressTime() const
+            { return (decompressions > 0)? static_cast<float>(decompress_ns) / decompressions / 1000.0f : 0.0f; }
+    };
+
+    // All of these return nullptr if the file can't be opened, and
+    // OpenCompressed also if a bank doesn't unpack to what it was
+    static std::unique_ptr<RomImage> Open(const std::string& path);
+    static std::unique_ptr<RomImage> OpenPaged(const std::string& path, int pool_banks);
+    static std::unique_ptr<RomImage> OpenCompressed(const std::string& path, int pool_banks);
+    // Wraps an image that is already in memory
+    RomImage(std::vector<u8> bytes);
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    RomImage& operator=(const RomImage&) = delete;
+
+    // Returns a bank's 16 KiB; in paged mode the pointer is only
+    // good until the next call, unless it's bank 0 or mapped
+    const u8* GetBank(u32 bank)
+        { return paged? Load(bank, false) : data + bank * BANK_SIZE; }
+    // Like GetBank, for the bank switched in at 0x4000-0x7FFF;
+    // it stays resident until another bank is mapped
+    const u8* MapBank(u32 bank)
+        { return paged? Map(bank) : data + bank * BANK_SIZE; }
+    // Always whole banks, at least two of them
+    u32 GetBanks()
+        { return banks; }
+    bool IsMapped()
+        { return mapping != nullptr; }
+    bool IsPaged()
+        { return paged; }
+    Stats& GetStats()
+        { return stats; }
+
+private:
+    RomImage() {}
+    // Pads the in-memory copy out to whole banks
+    void Pad();
+
+    const u8* data = nullptr;
+    u32 banks = 0;
+    // Backing store when the image is neither mapped nor paged
+    std::vector<u8> bytes;
+    void* mapping = nullptr;
+
+    // Paged mode
+    struct Slot
+    {
+        static const u32 EMPTY = ~0U;
+        u32 bank = EMPTY;
+        u64 last_used = 0;
+        // Read in by a prefetch and not used since
+        bool prefetched = false;
+        std::vector<u8> data;
+    };
+    void InitPool(int pool_banks);
+    const u8* Load(u32 bank, bool prefetch);
+    const u8* Map(u32 bank);
+
+    bool paged = false;
+    // Where paged banks come from: the file, or else compressed copies
+    std::FILE* file = nullptr;
+    std::vector<std::vector<u8>> compressed;
+    std::vector<Slot> pool;
+    // Pool slot holding each bank, or -1
+    std::vector<int> resident;
+    // The bank that was last switched to from each bank
+    std::vector<u32> successor;
+    u32 mapped_bank = 1;
+    u64 clock = 0;
+
+    Stats stats;
+};
+
+}; // namespace Core
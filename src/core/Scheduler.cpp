@@ -0,0 +1,75 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Scheduler.h"
+
+#include <algorithm>
+
+
+namespace Core {
+
+const u64 Scheduler::NEVER;
+
+Scheduler::Scheduler()
+{
+    heap.reserve(EVENT_COUNT);
+}
+
+void Scheduler::Schedule(EventType type, u64 delay)
+{
+    Cancel(type);
+
+    heap.push_back({ now + delay, type });
+    std::push_heap(heap.begin(), heap.end(), Later);
+    next = heap.front().time;
+}
+
+void Scheduler::Cancel(EventType type)
+{
+    for(auto it = heap.begin(); it != heap.end(); it++)
+    {
+        if(it->type == type)
+        {
+            heap.erase(it);
+            std::make_heap(heap.begin(), heap.end(), Later);
+            next = heap.empty()? NEVER : heap.front().time;
+            return;
+        }
+    }
+}
+
+bool Scheduler::IsScheduled(EventType type)
+{
+    for(auto& event : heap)
+    {
+        if(event.type == type)
+            return true;
+    }
+    return false;
+}
+
+bool Scheduler::PopDue(EventType& type, u64& late)
+{
+    if(heap.empty() || heap.front().time > now)
+        return false;
+
+    type = heap.front().type;
+    late = now - heap.front().time;
+    std::pop_heap(heap.begin(), heap.end(), Later);
+    heap.pop_back();
+    next = heap.empty()? NEVER : heap.front().time;
+    return true;
+}
+
+}; // namespace Core
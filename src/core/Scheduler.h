@@ -0,0 +1,82 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../common/Types.h"
+
+#include <vector>
+
+
+namespace Core {
+
+// Things that happen at a known point in the future
+enum EventType : u8
+{
+    EVENT_PPU,
+    EVENT_TIMER,
+    EVENT_DMA,
+    EVENT_SERIAL,
+    EVENT_COUNT
+};
+
+// Keeps pending events in a binary heap ordered by the
+// master cycle count they are due at; each type of
+// event is pending at most once
+class Scheduler
+{
+    // Compiled code checks for due events itself
+    friend class Recompiler;
+
+    struct Event
+    {
+        u64 time;
+        EventType type;
+    };
+    std::vector<Event> heap;
+    // Orders the heap so the earliest event is on top
+    static bool Later(const Event& a, const Event& b)
+        { return a.time > b.time; }
+
+    // Master cycle counter
+    u64 now = 0;
+    // Cached time of the earliest event
+    u64 next = NEVER;
+
+public:
+    static const u64 NEVER = ~0ULL;
+
+    Scheduler();
+
+    // Replaces any pending event of the same type
+    void Schedule(EventType type, u64 delay);
+    void Cancel(EventType type);
+    bool IsScheduled(EventType type);
+
+    // Pops the earliest event if it is due, returning
+    // false once nothing else is
+    bool PopDue(EventType& type, u64& late);
+
+    void Advance(int cycles)
+        { now += cycles; }
+    bool HasDue()
+        { return now >= next; }
+    u64 GetNow()
+        { return now; }
+    // Cycles until the next event, or NEVER
+    u64 CyclesUntilNext()
+        { return (next == NEVER)? NEVER : (next > now)? next - now : 0; }
+};
+
+}; // namespace Core
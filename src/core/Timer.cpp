@@ -0,0 +1,129 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Timer.h"
+#include "Scheduler.h"
+#include "memory/MemoryBus.h"
+
+
+namespace Core {
+
+Timer::Timer(std::shared_ptr<Memory::MemoryBus>& memory_bus,
+             Scheduler& scheduler)
+:
+    memory_bus (memory_bus),
+    scheduler (scheduler)
+{
+    Memory::IORegister& div = memory_bus->RegisterIO(0xFF04, this);
+    div.read = Memory::IORead<Timer, &Timer::ReadDIV>;
+    div.write = Memory::IOWrite<Timer, &Timer::WriteDIV>;
+    Memory::IORegister& tima = memory_bus->RegisterIO(0xFF05, this);
+    tima.read = Memory::IORead<Timer, &Timer::ReadTIMA>;
+    tima.write = Memory::IOWrite<Timer, &Timer::WriteTIMA>;
+    memory_bus->RegisterIO(0xFF06, this, &TMA).write = Memory::IOWrite<Timer, &Timer::WriteTMA>;
+    Memory::IORegister& tac = memory_bus->RegisterIO(0xFF07, this, &TAC);
+    tac.write = Memory::IOWrite<Timer, &Timer::WriteTAC>;
+    tac.read_mask = 0x07;
+}
+
+int Timer::Period()
+{
+    // 4096Hz, 262144Hz, 65536Hz, 16384Hz
+    static const int PERIODS[4] = { 1024, 16, 64, 256 };
+    return PERIODS[TAC & 0x03];
+}
+
+void Timer::Sync()
+{
+    if(!Enabled())
+    {
+        tima_base = scheduler.GetNow();
+        return;
+    }
+
+    u64 ticks = (scheduler.GetNow() - tima_base) / Period();
+    // An overflow can be due before its event has been run
+    bool overflowed = false;
+    while(ticks >= static_cast<u64>(0x100 - TIMA))
+    {
+        ticks -= 0x100 - TIMA;
+        tima_base += (0x100 - TIMA) * static_cast<u64>(Period());
+        // Reload from TMA and request the timer interrupt
+        TIMA = TMA;
+        memory_bus->Write8(0xFF0F, memory_bus->Read8(0xFF0F) | 0x04);
+        overflowed = true;
+    }
+    TIMA += static_cast<u8>(ticks);
+    tima_base += ticks * Period();
+    if(overflowed)
+        ScheduleOverflow();
+}
+
+void Timer::ScheduleOverflow()
+{
+    if(!Enabled())
+    {
+        scheduler.Cancel(EVENT_TIMER);
+        return;
+    }
+    u64 until = (0x100 - TIMA) * static_cast<u64>(Period());
+    scheduler.Schedule(EVENT_TIMER, until - (scheduler.GetNow() - tima_base));
+}
+
+u8 Timer::ReadDIV()
+{
+    // Increments at 16384Hz
+    return static_cast<u8>((scheduler.GetNow() - div_base) / 256);
+}
+
+void Timer::WriteDIV(u8 data)
+{
+    // Writing any value resets it
+    div_base = scheduler.GetNow();
+}
+
+u8 Timer::ReadTIMA()
+{
+    Sync();
+    return TIMA;
+}
+
+void Timer::WriteTIMA(u8 data)
+{
+    Sync();
+    TIMA = data;
+    ScheduleOverflow();
+}
+
+void Timer::WriteTMA(u8 data)
+{
+    TMA = data;
+}
+
+void Timer::WriteTAC(u8 data)
+{
+    Sync();
+    TAC = data & 0x07;
+    tima_base = scheduler.GetNow();
+    ScheduleOverflow();
+}
+
+void Timer::Overflow(u64 late)
+{
+    // Sync does the reload, as of when the overflow was due
+    Sync();
+    ScheduleOverflow();
+}
+
+}; // namespace Core
@@ -0,0 +1,69 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../common/Types.h"
+
+#include <memory>
+
+
+namespace Memory {
+    class MemoryBus;
+}; // namespace Memory
+
+namespace Core {
+class Scheduler;
+
+// DIV and TIMA are worked out from the master cycle counter
+// when read; the only event is TIMA overflowing
+class Timer
+{
+    // Timer registers
+    u8 TIMA = 0; // timer counter; incremented at TAC frequency
+    u8 TMA = 0;  // timer modulo; when timer overflows, loads this value
+    u8 TAC = 0;  // timer control; control speed of TIMA
+
+    // Cycle DIV was last reset at
+    u64 div_base = 0;
+    // Cycle TIMA last held the value above
+    u64 tima_base = 0;
+
+    std::shared_ptr<Memory::MemoryBus> memory_bus;
+    Scheduler& scheduler;
+
+    bool Enabled()
+        { return (TAC & 0x04) != 0; }
+    // Cycles per TIMA increment
+    int Period();
+    // Bring TIMA up to date, reloading it if it has overflowed
+    void Sync();
+    void ScheduleOverflow();
+
+public:
+    Timer(std::shared_ptr<Memory::MemoryBus>& memory_bus,
+          Scheduler& scheduler);
+
+    u8 ReadDIV();
+    void WriteDIV(u8 data);
+    u8 ReadTIMA();
+    void WriteTIMA(u8 data);
+    void WriteTMA(u8 data);
+    void WriteTAC(u8 data);
+
+    // Called by the scheduler when TIMA overflows
+    void Overflow(u64 late);
+};
+
+}; // namespace Core
@@ -19,149 +19,66 @@
 #include "mbc/MBC3.h"
 
 #include "../GameBoy.h"
-#include "../PPU.h"
 #include "../Rom.h"
-#include "../processor/Processor.h"
 
-#include "../../common/Globals.h"
+#include "../../debug/Logger.h"
 
 #include <string>
 
 
-static bool CheckBounds8(u16 address)
-{
-    if((address >= 0xE000 && address <= 0xFDFF) ||
-       (address >= 0xFEA0 && address <= 0xFEFF))
-        return false;
+namespace Memory {
 
-    return true;
-}
-static bool CheckBounds16(u16 address)
+MemoryBus::MemoryBus(Core::GameBoy* gameboy)
+:
+    gameboy (gameboy)
 {
-    if((address >= 0xE000 && address <= 0xFDFF) ||
-       (address+1 >= 0xE000 && address+1 <= 0xFDFF) ||
-       (address >= 0xFEA0 && address <= 0xFEFF) ||
-       (address+1 >= 0xFEA0 && address+1 <= 0xFEFF))
-        return false;
-
-    return true;
+    RegisterIO(0xFF50, this).write = IOWrite<MemoryBus, &MemoryBus::DisableBootROM>;
 }
 
+IORegister& MemoryBus::RegisterIO(u16 address, void* owner, u8* value)
+{
+    IORegister& reg = io_registers[IOIndex(address)];
+    reg = IORegister();
+    reg.owner = owner;
+    reg.value = value;
+    return reg;
+}
 
-namespace Memory {
-
-bool MemoryBus::TryIOWrite(u16 address, u8 data)
+void MemoryBus::WatchWrites(int first, int last, void* owner, WriteWatcher notify)
 {
-    if((address >= 0xFF00 && address < 0xFF80) || address == 0xFFFF)
+    for(int i = first; i <= last; i++)
     {
-        switch(address & 0x00FF)
-        {
-        case 0x00:
-            // Controller input
-            // 0x30 means no controller polling
-            gameboy->P1 = (gameboy->P1 & 0x0F) | (data & 0x30);
-            break;
-        case 0x0F:
-            // interrupt request flags
-            gameboy->processor->IF = data;
-            break;
-        case 0x40:
-            gameboy->ppu->LCDC = data;
-            break;
-        case 0x41:
-            gameboy->ppu->STAT = data;
-            break;
-        case 0x42:
-            gameboy->ppu->SCY = data;
-            break;
-        case 0x43:
-            gameboy->ppu->SCX = data;
-            break;
-        case 0x44:
-            // Writing to this resets it
-            gameboy->ppu->LY = 0;
-            break;
-        case 0x45:
-            gameboy->ppu->LYC = data;
-            break;
-        case 0x46:
-            gameboy->processor->StartDMATransfer(data);
-            break;
-        case 0x47:
-            gameboy->ppu->BGPalette[0] = gColors[(data & 0b00000011) >> 0];
-            gameboy->ppu->BGPalette[1] = gColors[(data & 0b00001100) >> 2];
-            gameboy->ppu->BGPalette[2] = gColors[(data & 0b00110000) >> 4];
-            gameboy->ppu->BGPalette[3] = gColors[(data & 0b11000000) >> 6];
-            break;
-        case 0x48:
-            gameboy->ppu->OBJ0Palette[0] = gColors[(data & 0b00000011) >> 0];
-            gameboy->ppu->OBJ0Palette[1] = gColors[(data & 0b00001100) >> 2];
-            gameboy->ppu->OBJ0Palette[2] = gColors[(data & 0b00110000) >> 4];
-            gameboy->ppu->OBJ0Palette[3] = gColors[(data & 0b11000000) >> 6];
-            break;
-        case 0x49:
-            gameboy->ppu->OBJ1Palette[0] = gColors[(data & 0b00000011) >> 0];
-            gameboy->ppu->OBJ1Palette[1] = gColors[(data & 0b00001100) >> 2];
-            gameboy->ppu->OBJ1Palette[2] = gColors[(data & 0b00110000) >> 4];
-            gameboy->ppu->OBJ1Palette[3] = gColors[(data & 0b11000000) >> 6];
-            break;
-        case 0x4A:
-            gameboy->ppu->WY = data;
-            break;
-        case 0x4B:
-            gameboy->ppu->WX = data;
-            break;
-        case 0x50:
-            // replace ROM interrupt vectors
-            gameboy->memory_bus->WriteBytes(gameboy->game_rom->GetBytes().data(), 0x0000, 0x100);
-            gameboy->InBootROM = false;
-            break;
-        case 0xFF:
-            // interrupt enable flags
-            gameboy->processor->IE = data;
-            break;
-        }
-
-        return true;
+        write_watches[i].owner = owner;
+        write_watches[i].notify = notify;
+        // Otherwise InitMBC picks it up
+        if(mbc)
+            WatchPage(i);
     }
-
-    return false;
 }
 
-bool MemoryBus::TryIORead(u16 address, u8& retval)
+void MemoryBus::WatchPage(int page)
 {
-    if((address >= 0xFF00 && address < 0xFF80) || address == 0xFFFF)
-    {
-        switch(address & 0x00FF)
-        {
-        case 0x00:
-            retval = gameboy->P1 | 0xC0; break;
-        case 0x0F:
-            retval = gameboy->processor->IF; break;
-        case 0x40:
-            retval = gameboy->ppu->LCDC; break;
-        case 0x41:
-            retval = gameboy->ppu->STAT; break;
-        case 0x42:
-            retval = gameboy->ppu->SCY; break;
-        case 0x43:
-            retval = gameboy->ppu->SCX; break;
-        case 0x44:
-            retval = gameboy->ppu->LY; break;
-        case 0x45:
-            retval = gameboy->ppu->LYC; break;
-        case 0x4A:
-            retval = gameboy->ppu->WY; break;
-        case 0x4B:
-            retval = gameboy->ppu->WX; break;
-        case 0xFF:
-            retval = gameboy->processor->IE; break;
-        }
+    write_watches[page].page = write_pages[page];
+    write_watches[page].handler = write_handlers[page];
+    write_pages[page] = nullptr;
+    write_handlers[page] = &MemoryBus::WriteWatched;
+}
 
-        return true;
-    }
+void MemoryBus::WriteWatched(u16 address, u8 data)
+{
+    WriteWatch& watch = write_watches[address >> 8];
+    watch.notify(watch.owner, address);
+    if(watch.page != nullptr)
+        watch.page[address & 0xFF] = data;
+    else
+        (this->*watch.handler)(address, data);
+}
 
-    return false;
+void MemoryBus::DisableBootROM(u8 data)
+{
+    // replace ROM interrupt vectors
+    UnmapBootROM();
+    gameboy->InBootROM = false;
 }
 
 void MemoryBus::InitMBC(std::unique_ptr<Core::Rom>& rom)
@@ -169,55 +86,172 @@ void MemoryBus::InitMBC(std::unique_ptr<Core::Rom>& rom)
     switch(rom->GetCartType())
     {
     case 0x00: // Cart Only
-        mbc = std::unique_ptr<MBC> (new MBC(gameboy)); break;
+        AttachMBC<MBC>(rom); break;
     case 0x01: // MBC1
-        mbc = std::unique_ptr<MBC> (new MBC1(gameboy)); break;
+        AttachMBC<MBC1>(rom); break;
     case 0x13: // MBC3 + RAM + BATTERY
-        mbc = std::unique_ptr<MBC> (new MBC3(gameboy)); break;
+        AttachMBC<MBC3>(rom); break;
     default:
-        break;
+        LOG_WARN("Unknown MBC type " + std::to_string(rom->GetCartType()) + ", running as ROM only");
+        AttachMBC<MBC>(rom); break;
         //throw std::runtime_error("MBC type unknown! " + std::to_string(rom->GetCartType()));
     }
+}
+
+template<typename Type>
+void MemoryBus::AttachMBC(std::unique_ptr<Core::Rom>& rom)
+{
+    Type* cart = new Type(gameboy);
+    mbc = std::unique_ptr<MBC> (cart);
+    cart->Type::Load(rom);
+    rom_bank = cart->Type::GetROMBank();
+
+    // Cartridge and RAM pages come from the MBC
+    for(int i = 0x00; i < 0xE0; i++)
+    {
+        read_handlers[i] = &MemoryBus::ReadMBC<Type>;
+        write_handlers[i] = &MemoryBus::WriteMBC<Type>;
+    }
+    MapPages<Type>(0x00, 0xDF);
+    // Echo RAM is left unusable
+    for(int i = 0xE0; i < 0xFE; i++)
+    {
+        read_pages[i] = write_pages[i] = nullptr;
+        read_handlers[i] = &MemoryBus::ReadUnusable;
+        write_handlers[i] = &MemoryBus::WriteUnusable;
+    }
+    // OAM shares its page with the unusable 0xFEA0-0xFEFF,
+    // and the IO registers theirs with HRAM and IE
+    oam = cart->GetPage(0xFE00)->GetRaw();
+    high_ram = cart->GetPage(0xFF80)->GetRaw();
+    read_pages[0xFE] = write_pages[0xFE] = nullptr;
+    read_handlers[0xFE] = &MemoryBus::ReadOAM;
+    write_handlers[0xFE] = &MemoryBus::WriteOAM;
+    read_pages[0xFF] = write_pages[0xFF] = nullptr;
+    read_handlers[0xFF] = &MemoryBus::ReadIO;
+    write_handlers[0xFF] = &MemoryBus::WriteIO;
 
-    mbc->Load(rom);
+    for(int i = 0; i < PAGE_COUNT; i++)
+    {
+        if(write_watches[i].notify != nullptr)
+            WatchPage(i);
+    }
 }
 
-void MemoryBus::Write8(u16 address, u8 data)
+void MemoryBus::MapBootROM(const std::vector<u8>& bootrom)
 {
-    if(!CheckBounds8(address))
-        return;
-    if(TryIOWrite(address, data))
-        return;
+    boot_rom = bootrom;
+    boot_rom.resize(0x100);
+    boot_rom_mapped = true;
+    read_pages[0x00] = boot_rom.data();
+}
 
-    mbc->Write8(address, data);
+void MemoryBus::UnmapBootROM()
+{
+    // Bank 0 never moves, so this is the only page to fix up
+    boot_rom_mapped = false;
+    read_pages[0x00] = mbc->GetReadPage(0x0000);
 }
 
-void MemoryBus::Write16(u16 address, u16 data)
+template<typename Type>
+void MemoryBus::MapPages(int first, int last)
 {
-    if(!CheckBounds16(address))
-        return;
+    Type* cart = static_cast<Type*>(mbc.get());
+    for(int i = first; i <= last; i++)
+    {
+        read_pages[i] = cart->Type::GetReadPage(i << 8);
+        write_pages[i] = cart->Type::GetWritePage(i << 8);
+    }
+    if(boot_rom_mapped && first == 0x00)
+        read_pages[0x00] = boot_rom.data();
+}
 
-    mbc->Write16(address, data);
+template<typename Type>
+u8 MemoryBus::ReadMBC(u16 address)
+{
+    return static_cast<Type*>(mbc.get())->Type::Read8(address);
 }
 
-u8 MemoryBus::Read8(u16 address)
+u8 MemoryBus::ReadOAM(u16 address)
 {
-    if(!CheckBounds8(address))
+    if(address >= 0xFEA0)
         return 0xFF;
+
+    return oam[address - 0xFE00];
+}
+
+u8 MemoryBus::ReadIO(u16 address)
+{
+    if(address >= 0xFF80 && address != 0xFFFF)
+        return high_ram[address - 0xFF80];
+
+    IORegister& reg = io_registers[IOIndex(address)];
+    reg.reads++;
     u8 data;
-    if(TryIORead(address, data))
-        return data;
+    if(reg.read != nullptr)
+        data = reg.read(reg.owner);
+    else if(reg.value != nullptr)
+        data = *reg.value;
+    else
+        data = 0xFF;
+    return data | ~reg.read_mask;
+}
+
+u8 MemoryBus::ReadUnusable(u16 address)
+{
+    return 0xFF;
+}
 
-    return mbc->Read8(address);
+template<typename Type>
+void MemoryBus::WriteMBC(u16 address, u8 data)
+{
+    Type* cart = static_cast<Type*>(mbc.get());
+    cart->Type::Write8(address, data);
+
+    if(address < 0x8000)
+    {
+        // MBC control register; see if it switched banks
+        u16 bank = cart->Type::GetROMBank();
+        if(bank != rom_bank)
+        {
+            rom_bank = bank;
+            bank_switches++;
+            MapPages<Type>(0x40, 0x7F);
+        }
+        // RAM pages move together, so the first one tells if they did
+        if(cart->Type::GetReadPage(0xA000) != read_pages[0xA0] ||
+           cart->Type::GetWritePage(0xA000) != write_pages[0xA0])
+            MapPages<Type>(0xA0, 0xBF);
+    }
+}
+
+void MemoryBus::WriteOAM(u16 address, u8 data)
+{
+    if(address >= 0xFEA0)
+        return;
+
+    oam[address - 0xFE00] = data;
 }
 
-u16 MemoryBus::Read16(u16 address)
+void MemoryBus::WriteIO(u16 address, u8 data)
 {
-    if(!CheckBounds16(address))
-        return 0xFFFF;
+    if(address >= 0xFF80 && address != 0xFFFF)
+    {
+        high_ram[address - 0xFF80] = data;
+        return;
+    }
 
-    return mbc->Read16(address);
+    IORegister& reg = io_registers[IOIndex(address)];
+    reg.writes++;
+    if(reg.write != nullptr)
+        reg.write(reg.owner, data);
+    else if(reg.value != nullptr)
+        *reg.value = (*reg.value & ~reg.write_mask) | (data & reg.write_mask);
 }
+
+void MemoryBus::WriteUnusable(u16 address, u8 data)
+{}
+
 // Use raw buffers for these rather than vectors
 // because man is std::vector slow...
 void MemoryBus::WriteBytes(const u8* src, u16 destination, u16 size)
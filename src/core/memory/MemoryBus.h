@@ -18,36 +18,165 @@
 #include "../../common/Types.h"
 
 #include <memory>
+#include <vector>
 
 
 namespace Core {
     class GameBoy;
+    class Recompiler;
     class Rom;
 }; // namespace Core
 
 namespace Memory {
 
+// IO register handlers; components bind their
+// member functions to these with IORead/IOWrite
+typedef u8 (*IOReadHandler)(void* owner);
+typedef void (*IOWriteHandler)(void* owner, u8 data);
+
+template<typename T, u8 (T::*Read)()>
+u8 IORead(void* owner)
+    { return (static_cast<T*>(owner)->*Read)(); }
+template<typename T, void (T::*Write)(u8)>
+void IOWrite(void* owner, u8 data)
+    { (static_cast<T*>(owner)->*Write)(data); }
+
+// Told about writes to a watched page, after they land
+typedef void (*WriteWatcher)(void* owner, u16 address);
+
+struct IORegister
+{
+    // Plain registers are read and written straight through
+    // value; a handler, where set, takes over that direction.
+    // With neither, reads see open bus and writes are dropped
+    u8* value = nullptr;
+    void* owner = nullptr;
+    IOReadHandler read = nullptr;
+    IOWriteHandler write = nullptr;
+    // Bits that read back; the rest always read as 1
+    u8 read_mask = 0xFF;
+    // Bits a write to a plain register can change
+    u8 write_mask = 0xFF;
+    // Accesses so far, for profiling
+    u32 reads = 0;
+    u32 writes = 0;
+};
+
 class MemoryBus
 {
+    // Compiled code reads and writes plain pages directly
+    friend class Core::Recompiler;
+
+public:
+    // The address space is mapped in 256-byte pages
+    static const int PAGE_COUNT = 0x100;
+    // 0xFF00-0xFF7F, then IE at 0xFFFF
+    static const int IO_COUNT = 0x80 + 1;
+
+private:
     Core::GameBoy* gameboy;
     std::unique_ptr<MBC> mbc;
 
-    bool TryIOWrite(u16 address, u8 data);
-    bool TryIORead(u16 address, u8& retval);
+    // ROM bank mapped at 0x4000-0x7FFF and how many times it changed
+    u16 rom_bank = 1;
+    u32 bank_switches = 0;
+
+    // Boot ROM laid over 0x0000-0x00FF until it unmaps itself
+    std::vector<u8> boot_rom;
+    bool boot_rom_mapped = false;
+
+    // Pages of plain memory point straight at it; the rest
+    // are null and go to their page's handler instead
+    typedef u8 (MemoryBus::*ReadHandler)(u16 address);
+    typedef void (MemoryBus::*WriteHandler)(u16 address, u8 data);
+    u8* read_pages[PAGE_COUNT];
+    u8* write_pages[PAGE_COUNT];
+    ReadHandler read_handlers[PAGE_COUNT];
+    WriteHandler write_handlers[PAGE_COUNT];
+
+    // Watched pages keep their memory or handler here instead
+    // of in the page table, so writes go through WriteWatched
+    struct WriteWatch
+    {
+        void* owner = nullptr;
+        WriteWatcher notify = nullptr;
+        u8* page = nullptr;
+        WriteHandler handler = nullptr;
+    };
+    WriteWatch write_watches[PAGE_COUNT];
+    void WatchPage(int page);
+    void WriteWatched(u16 address, u8 data);
+
+    // OAM and HRAM never move, so their pages' handlers use them directly
+    u8* oam = nullptr;
+    u8* high_ram = nullptr;
+
+    // The cartridge handlers are instantiated per MBC type and
+    // picked once in InitMBC, so they call it without virtual dispatch
+    template<typename Type> void AttachMBC(std::unique_ptr<Core::Rom>& rom);
+    // Points the pages in [first, last] at whatever the MBC has mapped there
+    template<typename Type> void MapPages(int first, int last);
+    template<typename Type> u8 ReadMBC(u16 address);
+    template<typename Type> void WriteMBC(u16 address, u8 data);
+
+    u8 ReadOAM(u16 address);
+    u8 ReadIO(u16 address);
+    u8 ReadUnusable(u16 address);
+    void WriteOAM(u16 address, u8 data);
+    void WriteIO(u16 address, u8 data);
+    void WriteUnusable(u16 address, u8 data);
+
+    // IO registers, filled in by each component as it is built
+    IORegister io_registers[IO_COUNT];
+    static int IOIndex(u16 address)
+        { return (address == 0xFFFF)? IO_COUNT - 1 : (address & 0x7F); }
+
+    void DisableBootROM(u8 data);
 
 public:
-    MemoryBus(Core::GameBoy* gameboy)
-    :   gameboy(gameboy) {}
+    MemoryBus(Core::GameBoy* gameboy);
 
     void InitMBC(std::unique_ptr<Core::Rom>& rom);
+    void MapBootROM(const std::vector<u8>& bootrom);
+    void UnmapBootROM();
 
-    void Write8(u16 address, u8 data);
-    void Write16(u16 address, u16 data);
-    u8 Read8(u16 address);
-    u16 Read16(u16 address);
+    void Write8(u16 address, u8 data)
+    {
+        u8* page = write_pages[address >> 8];
+        if(page != nullptr)
+            page[address & 0xFF] = data;
+        else
+            (this->*write_handlers[address >> 8])(address, data);
+    }
+    u8 Read8(u16 address)
+    {
+        const u8* page = read_pages[address >> 8];
+        if(page != nullptr)
+            return page[address & 0xFF];
+        return (this->*read_handlers[address >> 8])(address);
+    }
+    void Write16(u16 address, u16 data)
+        { Write8(address, data & 0x00FF); Write8(address + 1, data >> 8); }
+    u16 Read16(u16 address)
+        { return Read8(address) | (Read8(address + 1) << 8); }
 
     void WriteBytes(const u8* src, u16 destination, u16 size);
     void ReadBytes(u8* destination, u16 src, u16 size);
+
+    // Hands the IO register at address to owner, backed by value;
+    // handlers and masks are then set on the returned entry
+    IORegister& RegisterIO(u16 address, void* owner, u8* value = nullptr);
+    const IORegister& GetIORegister(u16 address)
+        { return io_registers[IOIndex(address)]; }
+    // Calls notify just before each write to the pages [first, last]
+    // lands; not for the banked ROM and SRAM pages, which are
+    // remapped on a switch
+    void WatchWrites(int first, int last, void* owner, WriteWatcher notify);
+
+    u16 GetROMBank()
+        { return rom_bank; }
+    u32 GetBankSwitches()
+        { return bank_switches; }
 };
 
 }; // namespace Memory
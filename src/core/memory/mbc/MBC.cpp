@@ -16,6 +16,7 @@
 
 #include "../../GameBoy.h"
 #include "../../Rom.h"
+#include "../../RomImage.h"
 
 #include <string>
 #include <cstring>
@@ -25,8 +26,8 @@ namespace Memory {
 
 MBC::MBC(Core::GameBoy* gameboy)
 :   gameboy(gameboy),
-    romBank0(new MemoryPage(0x0000, 0x4000)),
-    romBank1(new MemoryPage(0x4000, 0x4000)),
+    romBank0(new MemoryPage(0x0000, 0x4000, nullptr)),
+    romBank1(new MemoryPage(0x4000, 0x4000, nullptr)),
     vram(new MemoryPage(0x8000, 0x2000)),
     sram(new MemoryPage(0xA000, 0x2000)),
     wram(new MemoryPage(0xC000, 0x2000)),
@@ -36,8 +37,12 @@ MBC::MBC(Core::GameBoy* gameboy)
 
 void MBC::Load(std::unique_ptr<Core::Rom>& rom)
 {
-    WriteBytes(rom->GetBytes().data(), 0x0000, 0x4000);
-    WriteBytes(rom->GetBytes().data()+0x4000, 0x4000, 0x4000);
+    // ROM pages are never written through; writes
+    // below 0x8000 go to the MBC registers instead
+    romImage = rom->GetImage();
+    romBanks = romImage->GetBanks();
+    romBank0->Map(const_cast<u8*>(romImage->GetBank(0)));
+    romBank1->Map(const_cast<u8*>(romImage->MapBank(1)));
 }
 
 std::unique_ptr<MemoryPage>& MBC::GetPage(u16 address)
@@ -60,13 +65,31 @@ std::unique_ptr<MemoryPage>& MBC::GetPage(u16 address)
     //throw std::out_of_range("Address out of bounds!");
 }
 
+u8* MBC::GetReadPage(u16 address)
+{
+    std::unique_ptr<MemoryPage>& page = GetPage(address);
+    return page->GetRaw() + (address - page->GetBase());
+}
+
+u8* MBC::GetWritePage(u16 address)
+{
+    // ROM is read-only; writes there go to the MBC's registers
+    if(address < 0x8000)
+        return nullptr;
+
+    return GetReadPage(address);
+}
+
 void MBC::Write8(u16 address, u8 data)
 {
+    // ROM is read-only
+    if(address < 0x8000)
+        return;
     //try
     {
         std::unique_ptr<MemoryPage>& page = GetPage(address);
         address -= page->GetBase();
-        page->GetBytes().at(address) = data;
+        page->GetRaw()[address] = data;
     }
     //catch(std::out_of_range& e)
     {
@@ -80,8 +103,8 @@ void MBC::Write16(u16 address, u16 data)
     {
         std::unique_ptr<MemoryPage>& page = GetPage(address);
         address -= page->GetBase();
-        page->GetBytes().at(address) = data & 0x00FF;
-        page->GetBytes().at(address + 1) = (data & 0xFF00) >> 8;
+        page->GetRaw()[address] = data & 0x00FF;
+        page->GetRaw()[address + 1] = (data & 0xFF00) >> 8;
     }
     //catch(std::out_of_range& e)
     {
@@ -95,7 +118,7 @@ u8 MBC::Read8(u16 address)
     {
         std::unique_ptr<MemoryPage>& page = GetPage(address);
         address -= page->GetBase();
-        return page->GetBytes().at(address);
+        return page->GetRaw()[address];
     }
     //catch(std::out_of_range& e)
     {
@@ -110,7 +133,7 @@ u16 MBC::Read16(u16 address)
     {
         std::unique_ptr<MemoryPage>& page = GetPage(address);
         address -= page->GetBase();
-        return page->GetBytes().at(address) | (page->GetBytes().at(address + 1) << 8);
+        return page->GetRaw()[address] | (page->GetRaw()[address + 1] << 8);
     }
     //catch(std::out_of_range& e)
     {
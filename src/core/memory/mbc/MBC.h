@@ -22,6 +22,7 @@
 namespace Core {
     class GameBoy;
     class Rom;
+    class RomImage;
 }; // namespace Core
 
 namespace Memory {
@@ -30,17 +31,26 @@ class MemoryPage
 {
     u16 base;
     u32 size;
+    // Only used when the page owns its memory
     std::vector<u8> bytes;
+    u8* data;
 public:
     MemoryPage(u16 base, u32 size)
     : base(base),
       size(size),
-      bytes(size) {}
+      bytes(size),
+      data(bytes.data()) {}
+    // A view onto memory owned elsewhere, like cartridge ROM
+    MemoryPage(u16 base, u32 size, u8* data)
+    : base(base),
+      size(size),
+      data(data) {}
 
     u16 GetBase() { return base; }
     u32 GetSize() { return size; }
-    std::vector<u8>& GetBytes() { return bytes; }
-    u8* GetRaw() { return bytes.data(); }
+    u8* GetRaw() { return data; }
+    // Points a view somewhere else, e.g. on a bank switch
+    void Map(u8* data) { this->data = data; }
 };
 
 class MBC
@@ -48,6 +58,10 @@ class MBC
 protected:
     Core::GameBoy* gameboy;
 
+    // Cartridge ROM, owned by Core::Rom; the ROM pages are views into it
+    Core::RomImage* romImage = nullptr;
+    u32 romBanks = 0;
+
     std::unique_ptr<MemoryPage> romBank0;
     std::unique_ptr<MemoryPage> romBank1;
     std::unique_ptr<MemoryPage> vram;
@@ -61,6 +75,13 @@ public:
     virtual void Load(std::unique_ptr<Core::Rom>& rom);
 
     virtual std::unique_ptr<MemoryPage>& GetPage(u16 address);
+    // Where the 256-byte page holding an address currently lives, or
+    // nullptr if accesses to it have to go through Read8/Write8
+    virtual u8* GetReadPage(u16 address);
+    virtual u8* GetWritePage(u16 address);
+    // Bank currently mapped at 0x4000-0x7FFF
+    virtual u16 GetROMBank()
+        { return 1; }
 
     virtual void Write8(u16 address, u8 data);
     virtual void Write16(u16 address, u16 data);
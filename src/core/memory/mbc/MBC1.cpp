@@ -16,10 +16,9 @@
 
 #include "../../GameBoy.h"
 #include "../../Rom.h"
+#include "../../RomImage.h"
 
-#include <cmath>
 #include <string>
-#include <cstring>
 
 
 namespace Memory {
@@ -35,31 +34,22 @@ MBC1::MBC1(Core::GameBoy* gameboy)
 
 void MBC1::Load(std::unique_ptr<Core::Rom>& rom)
 {
-    WriteBytes(rom->GetBytes().data(), 0x0000, 0x4000);
-    // initialize all ROM banks
-    u16 romSize = 32 * pow(2, rom->GetROMSize());
-    u8 banks = romSize / 16; 
+    MBC::Load(rom);
+    MapROMBank();
 
-    numBanks = banks;
-
-    for(int i = 1; i < banks; i++) {
-        switchableBanks.push_back(std::unique_ptr<MemoryPage>(new MemoryPage(0x4000, 0x4000)));
-
-        memcpy(switchableBanks.at(i-1)->GetRaw(), rom->GetBytes().data() + (0x4000*i), 0x4000);
-    }
     for(int i = 0; i < 4; i++) {
         ramBanks[i] = std::unique_ptr<MemoryPage>(new MemoryPage(0xA000, 0x2000));
     }
 }
 
+void MBC1::MapROMBank()
+{
+    // Banks past the end of the ROM wrap around
+    romBank1->Map(const_cast<u8*>(romImage->MapBank(GetROMBank() % romBanks)));
+}
+
 std::unique_ptr<MemoryPage>& MBC1::GetPage(u16 address)
 {
-    if(address >= 0x4000 && address <= 0x7FFF) {
-        if(!ramBanking)
-            return switchableBanks.at(romBank - 1 | (selectedBank << 5));
-        else
-            return switchableBanks.at(romBank - 1);
-    }
     if(address >= 0xA000 && address <= 0xBFFF) {
         if(!extRamEnabled || !ramBanking)
             return ramBanks[0x00];
@@ -70,6 +60,32 @@ std::unique_ptr<MemoryPage>& MBC1::GetPage(u16 address)
     return MBC::GetPage(address);
 }
 
+u8* MBC1::GetReadPage(u16 address)
+{
+    // RAM banks that don't exist are left to Read8
+    if(address >= 0xA000 && address <= 0xBFFF &&
+       extRamEnabled && ramBanking && selectedBank >= 0x04)
+        return nullptr;
+
+    return MBC::GetReadPage(address);
+}
+
+u8* MBC1::GetWritePage(u16 address)
+{
+    if(address < 0x8000)
+        return nullptr;
+
+    return MBC1::GetReadPage(address);
+}
+
+u16 MBC1::GetROMBank()
+{
+    if(!ramBanking)
+        return (romBank - 1 | (selectedBank << 5)) + 1;
+    else
+        return romBank;
+}
+
 void MBC1::Write8(u16 address, u8 data)
 {
     if(address >= 0x0000 && address <= 0x1FFF)
@@ -86,11 +102,13 @@ void MBC1::Write8(u16 address, u8 data)
         if((data & 0x0F) == 0x00)
             data++;
         romBank = data & 0x1F;
+        MapROMBank();
         return;
     }
     if(address >= 0x4000 && address <= 0x5FFF)
     {
         selectedBank = data;
+        MapROMBank();
         return;
     }
     if(address >= 0x6000 && address <= 0x7FFF)
@@ -99,6 +117,7 @@ void MBC1::Write8(u16 address, u8 data)
             ramBanking = false;
         else
             ramBanking = true;
+        MapROMBank();
         return;
     }
     MBC::Write8(address, data);
@@ -22,19 +22,23 @@ class MBC1
 : public MBC
 {
 protected:
-    std::vector<std::unique_ptr<MemoryPage>> switchableBanks;
     u8 romBank;
-    u8 numBanks;
     bool extRamEnabled;
     bool ramBanking;
     std::unique_ptr<MemoryPage> ramBanks[0x04];
     u8 selectedBank;
 
+    // Points 0x4000-0x7FFF at the bank the registers select
+    void MapROMBank();
+
 public:
     MBC1(Core::GameBoy* gameboy);
     virtual void Load(std::unique_ptr<Core::Rom>& rom);
 
     virtual std::unique_ptr<MemoryPage>& GetPage(u16 address);
+    virtual u8* GetReadPage(u16 address);
+    virtual u8* GetWritePage(u16 address);
+    virtual u16 GetROMBank();
 
     virtual void Write8(u16 address, u8 data);
 };
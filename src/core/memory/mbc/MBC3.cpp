@@ -26,13 +26,23 @@ MBC3::MBC3(Core::GameBoy* gameboy)
     // TODO: RTC, Battery
 }
 
-std::unique_ptr<MemoryPage>& MBC3::GetPage(u16 address)
+u8* MBC3::GetReadPage(u16 address)
 {
-    if(address >= 0x4000 && address <= 0x7FFF) {
-        return switchableBanks.at(romBank - 1);
+    // RAM reads ignore the enable and banking mode, and the
+    // RTC registers have no memory behind them
+    if(address >= 0xA000 && address <= 0xBFFF)
+    {
+        if(selectedBank >= 0x04)
+            return nullptr;
+        return ramBanks[selectedBank]->GetRaw() + (address - 0xA000);
     }
 
-    return MBC1::GetPage(address);
+    return MBC1::GetReadPage(address);
+}
+
+u16 MBC3::GetROMBank()
+{
+    return romBank;
 }
 
 void MBC3::Write8(u16 address, u8 data)
@@ -42,6 +52,7 @@ void MBC3::Write8(u16 address, u8 data)
         if((data & 0x7F) == 0x00)
             data++;
         romBank = data & 0x7F;
+        MapROMBank();
         return;
     }
 
@@ -56,7 +67,7 @@ u8 MBC3::Read8(u16 address)
         } else {
             //try
             {
-                return ramBanks[selectedBank]->GetBytes().at(address - 0xA000);
+                return ramBanks[selectedBank]->GetRaw()[address - 0xA000];
             }
             //catch(std::out_of_range& e)
             {
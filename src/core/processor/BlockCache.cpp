@@ -0,0 +1,222 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BlockCache.h"
+#include "Opcodes.h"
+#include "../memory/MemoryBus.h"
+
+
+// Jumps, calls, returns, restarts, HALT and STOP
+static bool EndsBlock(u8 opcode)
+{
+    switch(opcode)
+    {
+    case 0x10: case 0x76:
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9:
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+    case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9:
+        return true;
+    }
+    // RST XXh
+    return (opcode & 0xC7) == 0xC7;
+}
+
+
+namespace Core {
+
+BlockCache::BlockCache(std::shared_ptr<Memory::MemoryBus>& memory_bus,
+                       const MicroOpHandler* handlers,
+                       const MicroOpHandler* cb_handlers)
+:
+    handlers (handlers),
+    cb_handlers (cb_handlers),
+    memory_bus (memory_bus)
+{}
+
+const MicroOp* BlockCache::Resume(u16 pc, const MicroOp*& end)
+{
+    // Only cartridge ROM is immutable; code in
+    // RAM always goes through the interpreter
+    if(pc >= 0x8000)
+    {
+        current = nullptr;
+        next = this->end = nullptr;
+        stats.interpreted_instructions++;
+        return nullptr;
+    }
+    // A bank switch may have remapped the
+    // code under the block we stopped in
+    if(generation != memory_bus->GetBankSwitches())
+    {
+        generation = memory_bus->GetBankSwitches();
+        if(current != nullptr)
+            stats.invalidations++;
+        current = nullptr;
+        next = this->end = nullptr;
+    }
+    // Carry on through the block the last run stopped in
+    if(next != this->end && next->address == pc)
+    {
+        end = this->end;
+        return next;
+    }
+
+    const MicroOp* op = Chain(pc, end);
+    if(op == nullptr)
+        stats.interpreted_instructions++;
+    return op;
+}
+
+const MicroOp* BlockCache::Chain(u16 pc, const MicroOp*& end)
+{
+    if(pc >= 0x8000)
+        return nullptr;
+    Block* block = Enter(pc);
+    if(block == nullptr)
+        return nullptr;
+    end = block->ops.data() + block->ops.size();
+    return block->ops.data();
+}
+
+void BlockCache::Suspend(const MicroOp* next, const MicroOp* end, u32 executed)
+{
+    this->next = next;
+    this->end = end;
+    stats.cached_instructions += executed;
+}
+
+void BlockCache::Flush()
+{
+    if(current != nullptr)
+        stats.invalidations++;
+    blocks.clear();
+    current = nullptr;
+    next = end = nullptr;
+}
+
+void BlockCache::ForgetCompiled()
+{
+    for(auto& entry : blocks)
+    {
+        entry.second->code = nullptr;
+        entry.second->entries = 0;
+    }
+}
+
+Block* BlockCache::Enter(u16 pc)
+{
+    u16 bank = (pc >= 0x4000)? memory_bus->GetROMBank() : 0;
+    Block* previous = current;
+
+    // Try the blocks that followed this one last time
+    if(previous != nullptr)
+    {
+        for(Block* link : previous->links)
+        {
+            if(link != nullptr && link->start == pc && link->bank == bank)
+            {
+                stats.chained++;
+                current = link;
+                return current;
+            }
+        }
+    }
+
+    u32 key = (static_cast<u32>(bank) << 16) | pc;
+    auto it = blocks.find(key);
+    if(it != blocks.end())
+    {
+        stats.hits++;
+        current = it->second.get();
+    }
+    else
+    {
+        stats.misses++;
+        current = Decode(pc, bank);
+        if(current == nullptr)
+            return nullptr;
+        blocks[key] = std::unique_ptr<Block>(current);
+    }
+
+    // Chain it to the previous block; slot 0 is the
+    // fall-through path and slot 1 the branch target
+    if(previous != nullptr)
+    {
+        const MicroOp& last = previous->ops.back();
+        int slot = (pc == static_cast<u16>(last.address + last.length))? 0 : 1;
+        previous->links[slot] = current;
+    }
+
+    return current;
+}
+
+Block* BlockCache::Decode(u16 pc, u16 bank)
+{
+    // Blocks can't run past the end of the bank they start in
+    u16 limit = (pc < 0x4000)? 0x4000 : 0x8000;
+
+    Block* block = new Block();
+    block->start = pc;
+    block->bank = bank;
+    block->links[0] = block->links[1] = nullptr;
+    block->entries = 0;
+    block->code = nullptr;
+
+    while(block->ops.size() < MAX_BLOCK_OPS)
+    {
+        MicroOp op;
+        u8 opcode = memory_bus->Read8(pc);
+
+        op.address = pc;
+        op.operand = 0;
+        op.opcode = opcode;
+        if(opcode == 0xCB)
+        {
+            // Go straight to the extended handler
+            op.handler = cb_handlers[memory_bus->Read8(pc + 1)];
+            op.length = 2;
+        }
+        else
+        {
+            op.handler = handlers[opcode];
+            op.length = OPCODE_LOOKUP[opcode].length;
+            // Leave undefined opcodes to the interpreter
+            if(op.length == 0)
+                break;
+            if(op.length == 2)
+                op.operand = memory_bus->Read8(pc + 1);
+            else if(op.length == 3)
+                op.operand = memory_bus->Read16(pc + 1);
+        }
+
+        if(pc + op.length > limit)
+            break;
+
+        block->ops.push_back(op);
+        pc += op.length;
+
+        if(opcode != 0xCB && EndsBlock(opcode))
+            break;
+    }
+
+    if(block->ops.empty())
+    {
+        delete block;
+        return nullptr;
+    }
+    return block;
+}
+
+}; // namespace Core
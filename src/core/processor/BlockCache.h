@@ -0,0 +1,125 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../../common/Types.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Memory {
+    class MemoryBus;
+}; // namespace Memory
+
+namespace Core {
+class Processor;
+struct JitFrame;
+
+// Runs an instruction whose operand was decoded ahead of time
+typedef int (*MicroOpHandler)(Processor& cpu);
+// Runs a block translated to host code; see Recompiler
+typedef int (*CompiledBlock)(Processor* cpu, JitFrame* frame);
+
+// A pre-decoded instruction
+struct MicroOp
+{
+    MicroOpHandler handler;
+    u16 address;
+    u16 operand;
+    u8 length;
+    u8 opcode;
+};
+
+// A straight-line run of ROM code, ending at
+// the first instruction that changes control flow
+struct Block
+{
+    u16 start;
+    u16 bank;
+    std::vector<MicroOp> ops;
+    // Blocks that were entered right after this one
+    Block* links[2];
+    // Times entered from the start, and host code once it's hot
+    u32 entries;
+    CompiledBlock code;
+};
+
+class BlockCache
+{
+public:
+    struct Stats
+    {
+        // Block entries found in the cache
+        u32 hits = 0;
+        // Block entries that had to be decoded
+        u32 misses = 0;
+        // Block entries taken through a chain link
+        u32 chained = 0;
+        // Times the current block was dropped due to a bank switch or flush
+        u32 invalidations = 0;
+        // Instructions run out of the cache versus the interpreter
+        u32 cached_instructions = 0;
+        u32 interpreted_instructions = 0;
+    };
+
+    BlockCache(std::shared_ptr<Memory::MemoryBus>& memory_bus,
+               const MicroOpHandler* handlers,
+               const MicroOpHandler* cb_handlers);
+
+    // Returns the decoded instruction at pc and sets end to the end
+    // of its block, or returns nullptr if it must be interpreted;
+    // picks up mid-block where the last run was suspended
+    const MicroOp* Resume(u16 pc, const MicroOp*& end);
+    // Returns the first instruction of the block at pc, entered
+    // straight from the one just finished where possible
+    const MicroOp* Chain(u16 pc, const MicroOp*& end);
+    // Records where a run stopped and how many instructions it ran
+    void Suspend(const MicroOp* next, const MicroOp* end, u32 executed);
+    void Flush();
+    // Drops every block's host code and starts counting entries again
+    void ForgetCompiled();
+
+    // Block the last instruction returned belongs to
+    Block* GetCurrent()
+        { return current; }
+    Stats& GetStats()
+        { return stats; }
+    void ResetStats()
+        { stats = Stats(); }
+
+private:
+    static const int MAX_BLOCK_OPS = 64;
+
+    Block* Enter(u16 pc);
+    Block* Decode(u16 pc, u16 bank);
+
+    std::unordered_map<u32, std::unique_ptr<Block>> blocks;
+    // Block last entered and the instruction a run stopped at
+    Block* current = nullptr;
+    const MicroOp* next = nullptr;
+    const MicroOp* end = nullptr;
+    // Bank switch count the current block was entered under
+    u32 generation = 0;
+
+    const MicroOpHandler* handlers;
+    const MicroOpHandler* cb_handlers;
+    std::shared_ptr<Memory::MemoryBus> memory_bus;
+
+    Stats stats;
+};
+
+}; // namespace Core
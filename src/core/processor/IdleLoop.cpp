@@ -0,0 +1,157 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "IdleLoop.h"
+#include "Opcodes.h"
+#include "../memory/MemoryBus.h"
+
+
+// Memory a loop may poll without ever seeing it change between
+// events: work RAM and HRAM are only written by the CPU, which from
+// inside the loop means an interrupt handler, while LY, STAT and IF
+// only move when the PPU or another component's event runs.
+// DIV and TIMA count on their own and are left out
+static bool IsPolled(u16 address)
+{
+    if((address >= 0xC000 && address <= 0xDFFF) ||
+       (address >= 0xFF80 && address <= 0xFFFE))
+        return true;
+
+    return address == 0xFF0F || address == 0xFF41 || address == 0xFF44;
+}
+
+
+namespace Core {
+
+IdleLoopDetector::IdleLoopDetector(std::shared_ptr<Memory::MemoryBus>& memory_bus)
+:
+    memory_bus (memory_bus)
+{}
+
+int IdleLoopDetector::Check(u16 bank, u16 start, u16 branch)
+{
+    u32 key = (static_cast<u32>(bank) << 16) | start;
+    auto it = loops.find(key);
+    if(it != loops.end() && it->second.branch == branch)
+        return it->second.cycles;
+
+    auto forced = overrides.find(key);
+    int cycles;
+    if(forced != overrides.end())
+        cycles = forced->second? Analyze(start, branch, true) : 0;
+    else
+        cycles = Analyze(start, branch, false);
+
+    if(cycles > 0)
+        stats.detected++;
+    loops[key] = { branch, cycles };
+    return cycles;
+}
+
+void IdleLoopDetector::Override(u16 bank, u16 start, bool idle)
+{
+    u32 key = (static_cast<u32>(bank) << 16) | start;
+    overrides[key] = idle;
+    loops.erase(key);
+}
+
+void IdleLoopDetector::Flush()
+{
+    loops.clear();
+}
+
+int IdleLoopDetector::Analyze(u16 start, u16 branch, bool force)
+{
+    if(branch < start || branch - start > MAX_LOOP_BYTES)
+        return 0;
+
+    int cycles = 0;
+    // A has been reloaded from memory this pass, so
+    // whatever it held on the way in doesn't matter
+    bool loaded = false;
+    u16 pc = start;
+    while(pc < branch)
+    {
+        u8 opcode = memory_bus->Read8(pc);
+        if(opcode == 0xCB)
+        {
+            u8 cb = memory_bus->Read8(pc + 1);
+            // BIT b,A
+            if(!force && !((cb & 0xC7) == 0x47 && loaded))
+                return 0;
+            cycles += CB_OPCODE_LOOKUP[cb].cycles;
+            pc += 2;
+            continue;
+        }
+
+        if(!force)
+        {
+            switch(opcode)
+            {
+            case 0x00: // NOP
+                break;
+            case 0xF0: // LDH A,(u8)
+                if(!IsPolled(0xFF00 | memory_bus->Read8(pc + 1)))
+                    return 0;
+                loaded = true;
+                break;
+            case 0xFA: // LD A,(u16)
+                if(!IsPolled(memory_bus->Read8(pc + 1) | (memory_bus->Read8(pc + 2) << 8)))
+                    return 0;
+                loaded = true;
+                break;
+            // Only touch A and F, working from what was just loaded
+            case 0xFE: case 0xE6: case 0xEE: case 0xF6: // CP/AND/XOR/OR u8
+            case 0xA7: case 0xB7: case 0xBF: case 0x2F: // AND A, OR A, CP A, CPL
+                if(!loaded)
+                    return 0;
+                break;
+            default:
+                return 0;
+            }
+        }
+
+        if(OPCODE_LOOKUP[opcode].length == 0)
+            return 0;
+        cycles += OPCODE_LOOKUP[opcode].cycles;
+        pc += OPCODE_LOOKUP[opcode].length;
+    }
+    if(pc != branch)
+        return 0;
+
+    // The loop has to close with a jump straight back to its start
+    u8 opcode = memory_bus->Read8(branch);
+    switch(opcode)
+    {
+    case 0x18: // JR s8
+    case 0x20: case 0x28: case 0x30: case 0x38: // JR cc,s8
+        if(static_cast<u16>(branch + 2 + static_cast<s8>(memory_bus->Read8(branch + 1))) != start)
+            return 0;
+        break;
+    case 0xC3: // JP u16
+    case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc,u16
+        if((memory_bus->Read8(branch + 1) | (memory_bus->Read8(branch + 2) << 8)) != start)
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+    // Conditional branches list their taken time separately
+    int taken = OPCODE_LOOKUP[opcode].cycles_branch;
+    cycles += (taken != 0)? taken : OPCODE_LOOKUP[opcode].cycles;
+
+    return cycles;
+}
+
+}; // namespace Core
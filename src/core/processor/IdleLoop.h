@@ -0,0 +1,80 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../../common/Types.h"
+
+#include <memory>
+#include <unordered_map>
+
+
+namespace Memory {
+    class MemoryBus;
+}; // namespace Memory
+
+namespace Core {
+
+// Spots short ROM loops that do nothing but poll PPU or interrupt
+// state, so the CPU can skip ahead to the next event instead of
+// spinning through them one iteration at a time
+class IdleLoopDetector
+{
+public:
+    // Longest loop body looked at, in bytes
+    static const int MAX_LOOP_BYTES = 16;
+
+    struct Stats
+    {
+        // Loops found to be idle
+        u32 detected = 0;
+        // Times an idle loop was fast-forwarded
+        u32 skips = 0;
+        // Cycles skipped over in idle loops
+        u64 skipped_cycles = 0;
+    };
+
+    IdleLoopDetector(std::shared_ptr<Memory::MemoryBus>& memory_bus);
+
+    // Called when the branch at 'branch' jumps back to 'start';
+    // returns the cycles one pass through the loop takes,
+    // or 0 if running it again could change anything
+    int Check(u16 bank, u16 start, u16 branch);
+    // Forces the loop at an address to be treated as idle or not
+    void Override(u16 bank, u16 start, bool idle);
+    void Flush();
+
+    Stats& GetStats()
+        { return stats; }
+
+private:
+    struct Loop
+    {
+        u16 branch;
+        // Cycles per pass, 0 if the loop isn't idle
+        int cycles;
+    };
+
+    int Analyze(u16 start, u16 branch, bool force);
+
+    // Loops seen so far, keyed on (bank << 16) | start
+    std::unordered_map<u32, Loop> loops;
+    std::unordered_map<u32, bool> overrides;
+
+    Stats stats;
+
+    std::shared_ptr<Memory::MemoryBus> memory_bus;
+};
+
+}; // namespace Core
@@ -21,6 +21,48 @@
 
 namespace Core {
 
+u8 Processor::GetF() const
+{
+    u8 a = lazy_flags.a;
+    u8 b = lazy_flags.b;
+    u8 c = lazy_flags.carry;
+    u8 flags = 0;
+
+    switch(lazy_flags.op)
+    {
+    case FLAGS_NONE:
+        return reg_F;
+    case FLAGS_ADD:
+        flags |= (static_cast<u8>(a + b + c) == 0x00)? 0x80 : 0x00;
+        flags |= (((a & 0x0F) + (b & 0x0F) + c) & 0x10)? 0x20 : 0x00;
+        flags |= ((a + b + c) & 0x0100)? 0x10 : 0x00;
+        break;
+    case FLAGS_SUB:
+        flags |= (static_cast<u8>(a - b - c) == 0x00)? 0x80 : 0x00;
+        flags |= 0x40;
+        flags |= ((a & 0x0F) < ((b & 0x0F) + c))? 0x20 : 0x00;
+        flags |= (a < (b + c))? 0x10 : 0x00;
+        break;
+    case FLAGS_AND:
+        flags |= (a == 0x00)? 0x80 : 0x00;
+        flags |= 0x20;
+        break;
+    case FLAGS_OR:
+        flags |= (a == 0x00)? 0x80 : 0x00;
+        break;
+    case FLAGS_INC:
+        flags |= (static_cast<u8>(a + 1) == 0x00)? 0x80 : 0x00;
+        flags |= ((a & 0x0F) == 0x0F)? 0x20 : 0x00;
+        break;
+    case FLAGS_DEC:
+        flags |= (static_cast<u8>(a - 1) == 0x00)? 0x80 : 0x00;
+        flags |= 0x40;
+        flags |= ((a & 0x0F) == 0x00)? 0x20 : 0x00;
+        break;
+    }
+    return (reg_F & ~lazy_flags.mask) | flags;
+}
+
 // load
 void Processor::ld(Reg8& reg, u8 value)
 {
@@ -52,11 +94,8 @@ void Processor::ldAt(u16 addr, u16 value)
 // inc/dec
 void Processor::inc(Reg8& reg)
 {
-    SetSubtract( false );
-    SetHalfCarry( (reg & 0x0F) == 0x0F );
+    DeferFlags(FLAGS_INC, 0xE0, reg, 0);
     ++reg;
-
-    SetZero( reg == 0x00 );
 }
 void Processor::inc(Reg16& reg16)
 {
@@ -65,22 +104,14 @@ void Processor::inc(Reg16& reg16)
 void Processor::incAt(u16 addr)
 {
     u8 value = memory_bus->Read8(addr);
-
-    SetSubtract( false );
-    SetHalfCarry( (value & 0x0F) == 0x0F );
-    
+    DeferFlags(FLAGS_INC, 0xE0, value, 0);
     memory_bus->Write8(addr, ++value);
-
-    SetZero( value == 0x00 );
 }
 
 void Processor::dec(Reg8& reg)
 {
-    SetSubtract( true );
-    SetHalfCarry( (reg & 0x0F) == 0x00 );
+    DeferFlags(FLAGS_DEC, 0xE0, reg, 0);
     --reg;
-
-    SetZero( reg == 0x00 );
 }
 void Processor::dec(Reg16& reg16)
 {
@@ -89,24 +120,15 @@ void Processor::dec(Reg16& reg16)
 void Processor::decAt(u16 addr)
 {
     u8 value = memory_bus->Read8(addr);
-    
-    SetSubtract( true );
-    SetHalfCarry( (value & 0x0F) == 0x00 );
-
+    DeferFlags(FLAGS_DEC, 0xE0, value, 0);
     memory_bus->Write8(addr, --value);
-
-    SetZero( value == 0x00 );
 }
 
 // add
 void Processor::add(Reg8& reg, u8 value)
 {
-    u16 tempAdd = reg + value;
-    SetSubtract( false );
-    SetHalfCarry( ((reg & 0x0F) + (value & 0x0F)) & 0x10 );
-    SetCarry( tempAdd & 0x0100 );
-    SetZero( (tempAdd & 0x00FF) == 0x00 );
-    reg = static_cast<u8>(tempAdd);
+    DeferFlags(FLAGS_ADD, 0xF0, reg, value);
+    reg += value;
 }
 void Processor::add(Reg16& reg, u16 value)
 {
@@ -125,64 +147,41 @@ void Processor::add(Reg16& reg, s8 value)
 }
 void Processor::adc(Reg8& reg, u8 value)
 {
-    u16 tempAdd = reg + value + Carry();
-    SetSubtract( false );
-    SetHalfCarry( ((reg & 0x0F) + (value & 0x0F) + Carry()) & 0x10 );
-    SetCarry( tempAdd & 0x0100 );
-    SetZero( (tempAdd & 0x00FF) == 0x00 );
-    reg = tempAdd & 0x00FF;
+    u8 adder = Carry()? 1 : 0;
+    DeferFlags(FLAGS_ADD, 0xF0, reg, value, adder);
+    reg += value + adder;
 }
 
 // sub
 void Processor::sub(Reg8& reg, u8 value)
 {
-    SetSubtract( true );
-    SetHalfCarry( (reg & 0x0F) < (value & 0x0F) );
-    SetCarry( (reg < value) );
+    DeferFlags(FLAGS_SUB, 0xF0, reg, value);
     reg -= value;
-
-    SetZero( reg == 0x00 );
 }
 void Processor::sbc(Reg8& reg, u8 value)
 {
     u8 adder = Carry()? 1 : 0;
-    SetSubtract( true );
-    SetHalfCarry( (reg & 0x0F) < ((value & 0x0F) + adder) );
-    SetCarry( reg < (value + adder) );
+    DeferFlags(FLAGS_SUB, 0xF0, reg, value, adder);
     reg -= value + adder;
-
-    SetZero( reg == 0x00 );
 }
 
 // bitwise
 void Processor::and8(Reg8& reg, u8 value)
 {
     reg &= value;
-
-    SetSubtract( false );
-    SetHalfCarry( true );
-    SetCarry( false );
-    SetZero( reg == 0x00 );
+    DeferFlags(FLAGS_AND, 0xF0, reg, 0);
 }
 
 void Processor::xor8(Reg8& reg, u8 value)
 {
     reg ^= value;
-
-    SetSubtract( false );
-    SetHalfCarry( false );
-    SetCarry( false );
-    SetZero( reg == 0x00 );
+    DeferFlags(FLAGS_OR, 0xF0, reg, 0);
 }
 
 void Processor::or8(Reg8& reg, u8 value)
 {
     reg |= value;
-
-    SetSubtract( false );
-    SetHalfCarry( false );
-    SetCarry( false );
-    SetZero( reg == 0x00 );
+    DeferFlags(FLAGS_OR, 0xF0, reg, 0);
 }
 
 // daa
@@ -218,21 +217,23 @@ void Processor::daa()
 // compare
 void Processor::cp(u8 value)
 {
-    SetSubtract( true );
-    SetHalfCarry( (reg_A & 0x0F) < (value & 0x0F) );
-    SetCarry( reg_A < value );
-    SetZero( (reg_A == value) );
+    DeferFlags(FLAGS_SUB, 0xF0, reg_A, value);
 }
 
 // jump
-void Processor::jr(s8 amt)
+int Processor::jr(s8 amt)
 {
+    u16 branch = reg_PC.word - 2;
     reg_PC.word += amt;
+    // Jumping backwards may be closing an idle loop
+    return (amt < 0)? SkipIdleLoop(branch) : 0;
 }
 
-void Processor::jp(u16 addr)
+int Processor::jp(u16 addr)
 {
+    u16 branch = reg_PC.word - 3;
     reg_PC.word = addr;
+    return (addr <= branch)? SkipIdleLoop(branch) : 0;
 }
 
 void Processor::call(u16 addr)
@@ -16,8 +16,6 @@
 
 #include "../../common/Types.h"
 
-#include <string>
-
 
 // Colored immediate values
 #define OP2        "\e[31m$%02X\e[0m"
@@ -26,14 +24,14 @@
 // Opcode definitions
 struct Opcode
 {
-    std::string name;
+    const char* name;
     u8 length;
     u8 cycles;
     // For conditional branches
     u8 cycles_branch;
 };
 
-static const Opcode OPCODE_LOOKUP[256] = {
+static constexpr Opcode OPCODE_LOOKUP[256] = {
     {"NOP", 1, 4, 0},
     {"LD BC, " OP4, 3, 12, 0},
     {"LD (BC),A", 1, 8, 0},
@@ -68,7 +66,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"LD E, " OP2, 2, 8, 0},
     {"RRA", 1, 4, 0},
 
-    {"JR NZ, " OP2, 2, 12, 0},
+    {"JR NZ, " OP2, 2, 8, 12},
     {"LD HL, " OP4, 3, 12, 0},
     {"LD (HL+),A", 1, 8, 0},
     {"INC HL", 1, 8, 0},
@@ -76,7 +74,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"DEC H", 1, 4, 0},
     {"LD H, " OP2, 2, 8, 0},
     {"DAA", 1, 4, 0},
-    {"JR Z, " OP2, 2, 12, 0},
+    {"JR Z, " OP2, 2, 8, 12},
     {"ADD HL,HL", 1, 8, 0},
     {"LD A,(HL+)", 1, 8, 0},
     {"DEC HL", 1, 8, 0},
@@ -85,7 +83,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"LD L, " OP2, 2, 8, 0},
     {"CPL", 1, 4, 0},
 
-    {"JR NC, " OP2, 2, 12, 0},
+    {"JR NC, " OP2, 2, 8, 12},
     {"LD SP, " OP4, 3, 12, 0},
     {"LD (HL-),A", 1, 8, 0},
     {"INC SP", 1, 8, 0},
@@ -93,7 +91,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"DEC (HL)", 1, 12, 0},
     {"LD (HL), " OP2, 2, 12, 0},
     {"SCF", 1, 4, 0},
-    {"JR C, " OP2, 2, 12, 0},
+    {"JR C, " OP2, 2, 8, 12},
     {"ADD HL,SP", 1, 8, 0},
     {"LD A,(HL-)", 1, 8, 0},
     {"DEC SP", 1, 8, 0},
@@ -238,36 +236,36 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"CP (HL)", 1, 8, 0},
     {"CP A", 1, 4, 0},
 
-    {"RET NZ", 1, 20, 0},
+    {"RET NZ", 1, 8, 20},
     {"POP BC", 1, 12, 0},
-    {"JP NZ, " OP4, 3, 16, 0},
+    {"JP NZ, " OP4, 3, 12, 16},
     {"JP " OP4, 3, 16, 0},
-    {"CALL NZ, " OP4, 3, 24, 0},
+    {"CALL NZ, " OP4, 3, 12, 24},
     {"PUSH BC", 1, 16, 0},
     {"ADD A, " OP2, 2, 8, 0},
     {"RST 00H", 1, 16, 0},
-    {"RET Z", 1, 20, 0},
+    {"RET Z", 1, 8, 20},
     {"RET", 1, 16, 0},
-    {"JP Z, " OP4, 3, 16, 0},
+    {"JP Z, " OP4, 3, 12, 16},
     {"CB EXT", 1, 4, 0},
-    {"CALL Z, " OP4, 3, 24, 0},
+    {"CALL Z, " OP4, 3, 12, 24},
     {"CALL " OP4, 3, 24, 0},
     {"ADC A, " OP2, 2, 8, 0},
     {"RST 08H", 1, 16, 0},
 
-    {"RET NC", 1, 20, 0},
+    {"RET NC", 1, 8, 20},
     {"POP DE", 1, 12, 0},
-    {"JP NC, " OP4, 3, 16, 0},
+    {"JP NC, " OP4, 3, 12, 16},
     {"UNDEFINED", 0, 0, 0},
-    {"CALL NC, " OP4, 3, 24, 0},
+    {"CALL NC, " OP4, 3, 12, 24},
     {"PUSH DE", 1, 16, 0},
     {"SUB " OP2, 2, 8, 0},
     {"RST 10H", 1, 16, 0},
-    {"RET C", 1, 20, 0},
+    {"RET C", 1, 8, 20},
     {"RETI", 1, 16, 0},
-    {"JP C, " OP4, 3, 16, 0},
+    {"JP C, " OP4, 3, 12, 16},
     {"UNDEFINED", 0, 0, 0},
-    {"CALL C, " OP4, 3, 24, 0},
+    {"CALL C, " OP4, 3, 12, 24},
     {"UNDEFINED", 0, 0, 0},
     {"SBC A, " OP2, 2, 8, 0},
     {"RST 18H", 1, 16, 0},
@@ -291,7 +289,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
 
     {"LD A,(FF+" OP2 ")", 2, 12, 0},
     {"POP AF", 1, 12, 0},
-    {"LD A,(C)", 2, 8, 0},
+    {"LD A,(C)", 1, 8, 0},
     {"DI", 1, 4, 0},
     {"UNDEFINED", 0, 0, 0},
     {"PUSH AF", 1, 16, 0},
@@ -307,7 +305,7 @@ static const Opcode OPCODE_LOOKUP[256] = {
     {"RST 38H", 1, 16, 0}
 };
 
-static const Opcode CB_OPCODE_LOOKUP[256] = {
+static constexpr Opcode CB_OPCODE_LOOKUP[256] = {
     {"RLC B", 2, 8, 0},
     {"RLC C", 2, 8, 0},
     {"RLC D", 2, 8, 0},
@@ -18,6 +18,7 @@
 #include "../memory/MemoryBus.h"
 
 #include "../../debug/Logger.h"
+#include "../../debug/Tracer.h"
 
 
 namespace Core {
@@ -25,7 +26,12 @@ namespace Core {
 Processor::Processor(GameBoy* gameboy,
                      std::shared_ptr<Memory::MemoryBus>& memory_bus)
 :
+    ProcessorState (),
+    block_cache (memory_bus, GetDecodedHandlers(), GetCBHandlers()),
+    recompiler (gameboy, this, memory_bus),
+    idle_loops (memory_bus),
     gameboy (gameboy),
+    scheduler (gameboy->GetScheduler()),
     memory_bus (memory_bus)
 {
     if(gameboy->GetOptions().skip_bootrom) {
@@ -34,16 +40,190 @@ Processor::Processor(GameBoy* gameboy,
     }
 
     IME = true;
+    SetTracer(nullptr);
+
+    memory_bus->RegisterIO(0xFF0F, this, &IF);
+    memory_bus->RegisterIO(0xFF46, this).write = Memory::IOWrite<Processor, &Processor::StartDMATransfer>;
+    memory_bus->RegisterIO(0xFFFF, this, &IE);
 }
 
 int Processor::Tick()
 {
-    int new_cycles = ExecuteNext();
+    if(halted)
+        return TickHalted();
+
+    int new_cycles;
+    if(halt_bug)
+        new_cycles = ExecuteHaltBug();
+    else
+        new_cycles = (this->*interpret)();
     new_cycles += TickInterrupts();
 
     return new_cycles;
 }
 
+int Processor::RunCached(int budget)
+{
+    // The boot ROM overlays cartridge ROM, so it is never cached
+    if(!halted && !halt_bug && !gameboy->IsInBootROM())
+    {
+        const MicroOp* end;
+        const MicroOp* op = block_cache.Resume(reg_PC.word, end);
+        if(op != nullptr)
+            return RunBlocks(op, end, budget);
+    }
+
+    int cycles = Tick();
+    scheduler.Advance(cycles);
+    return cycles;
+}
+
+// Runs decoded instructions back to back, going from block to
+// block without leaving the loop, until an event is due, an
+// interrupt is taken, the keys or ROM bank need attention,
+// the CPU halts or stops, or the budget runs out
+int Processor::RunBlocks(const MicroOp* op, const MicroOp* end, int budget)
+{
+    u32 generation = memory_bus->GetBankSwitches();
+    int cycles = 0;
+    u32 executed = 0;
+    CompiledBlock compiled = Compiled(op);
+
+    while(true)
+    {
+        int new_cycles;
+        if(compiled != nullptr)
+        {
+            // Runs as far into the block as it can, advancing the
+            // scheduler as it goes, except for an instruction
+            // that stopped it with an interrupt pending
+            JitFrame frame;
+            frame.budget = budget - cycles;
+            frame.generation = generation;
+            frame.executed = 0;
+            frame.pending = 0;
+            cycles += compiled(this, &frame);
+            op += frame.executed;
+            executed += frame.executed;
+            new_cycles = frame.pending;
+            compiled = nullptr;
+        }
+        else
+        {
+            operand = op->operand;
+            reg_PC.word += op->length;
+            new_cycles = op->handler(*this);
+            op++;
+            executed++;
+        }
+
+        if(IME && (IE & IF))
+        {
+            int taken = TickInterrupts();
+            if(taken > 0)
+            {
+                new_cycles += taken;
+                op = end = nullptr;
+            }
+        }
+        scheduler.Advance(new_cycles);
+        cycles += new_cycles;
+
+        if(op == nullptr || cycles >= budget || scheduler.HasDue() ||
+           gameboy->KeysDirty() || memory_bus->GetBankSwitches() != generation)
+            break;
+
+        if(op == end)
+        {
+            // Blocks end at HALT and STOP
+            if(halted || halt_bug || gameboy->IsStopped())
+                break;
+            op = block_cache.Chain(reg_PC.word, end);
+            if(op == nullptr)
+                break;
+            compiled = Compiled(op);
+        }
+    }
+
+    block_cache.Suspend(op, end, executed);
+    return cycles;
+}
+
+// Host code for the block op starts, compiling it once it is hot
+CompiledBlock Processor::Compiled(const MicroOp* op)
+{
+    Block* block = block_cache.GetCurrent();
+    if(!use_jit || op != block->ops.data())
+        return nullptr;
+    if(block->code == nullptr && ++block->entries == Recompiler::HOT_ENTRIES)
+    {
+        block->code = recompiler.Compile(*block);
+        // Out of room; start again with whatever is hot from here on
+        if(block->code == nullptr)
+        {
+            block_cache.ForgetCompiled();
+            recompiler.Clear();
+        }
+    }
+    return block->code;
+}
+
+int Processor::TickHalted()
+{
+    if(IE & IF & 0x1F)
+    {
+        // Wake up; the interrupt is only serviced if IME is set,
+        // otherwise execution just carries on after the HALT
+        halted = false;
+        return 4 + TickInterrupts();
+    }
+
+    // Nothing can wake us before the next event,
+    // so skip straight to it instead of stepping
+    u64 until = scheduler.CyclesUntilNext();
+    int skip = MAX_HALT_SKIP;
+    if(until < static_cast<u64>(skip))
+        skip = static_cast<int>(until);
+    // Keep to whole machine cycles
+    skip = (skip < 4)? 4 : (skip + 3) & ~3;
+    halted_cycles += skip;
+    return skip;
+}
+
+int Processor::SkipIdleLoop(u16 branch)
+{
+    u16 start = reg_PC.word;
+    if(!gameboy->GetOptions().idle_loop_skip || branch >= 0x8000 ||
+       branch - start > IdleLoopDetector::MAX_LOOP_BYTES)
+        return 0;
+    // An interrupt is about to be taken, so the loop won't go round again
+    if(IME && (IE & IF & 0x1F))
+        return 0;
+
+    // The boot ROM gets a bank of its own so its loops
+    // aren't confused with the cartridge code underneath
+    u16 bank = (start >= 0x4000)? memory_bus->GetROMBank() : 0;
+    if(gameboy->IsInBootROM() && start < 0x0100)
+        bank = 0xFFFF;
+    int pass = idle_loops.Check(bank, start, branch);
+    if(pass == 0)
+        return 0;
+
+    // Nothing the loop polls can change before the next event,
+    // so run whole passes up to it in one go
+    u64 until = scheduler.CyclesUntilNext();
+    int skip = MAX_HALT_SKIP;
+    if(until < static_cast<u64>(skip))
+        skip = static_cast<int>(until);
+    skip = ((skip + pass - 1) / pass) * pass;
+
+    IdleLoopDetector::Stats& stats = idle_loops.GetStats();
+    if(skip > 0)
+        stats.skips++;
+    stats.skipped_cycles += skip;
+    return skip;
+}
+
 int Processor::TickInterrupts()
 {
     if(IME)
@@ -113,1261 +293,811 @@ void Processor::StartDMATransfer(u8 addrH)
     // The caller passes in the high byte
     // of the address to start writing from
     // This allows for 0x100 increments
+    dma_source = addrH << 8;
+    // One byte per machine cycle
+    scheduler.Schedule(EVENT_DMA, 160 * 4);
+}
+
+void Processor::FinishDMATransfer()
+{
     // Data is transfered in 40*4 bytes
     // chunks to OAM
-    u16 address = addrH << 8;
     const int totalBytes = 40*4;
     for(int i = 0; i < totalBytes; i++)
-        memory_bus->Write8(0xFE00+i, memory_bus->Read8(address+i));
+        memory_bus->Write8(0xFE00+i, memory_bus->Read8(dma_source+i));
+}
 
-    // TODO: cycle accuracy
+// Cycle counts are read out of the opcode tables at compile time
+static constexpr int Cycles(u8 opcode)
+    { return OPCODE_LOOKUP[opcode].cycles; }
+static constexpr int BranchCycles(u8 opcode)
+    { return OPCODE_LOOKUP[opcode].cycles_branch; }
+static constexpr int CBCycles(u8 opcode)
+    { return CB_OPCODE_LOOKUP[opcode].cycles; }
+
+// Register operands; field 6 is (HL)
+template<int field>
+inline u8 Processor::GetR8()
+    { return r8[R8Index(field)]; }
+template<>
+inline u8 Processor::GetR8<6>()
+    { return memory_bus->Read8(reg_HL.word); }
+template<int field>
+inline void Processor::SetR8(u8 value)
+    { r8[R8Index(field)] = value; }
+template<>
+inline void Processor::SetR8<6>(u8 value)
+    { memory_bus->Write8(reg_HL.word, value); }
+
+// LD r, r'; 0x40-0x7F except HALT
+template<u8 opcode>
+int Processor::OpLoad()
+{
+    SetR8<(opcode >> 3) & 7>(GetR8<opcode & 7>());
+    return Cycles(opcode);
 }
 
-// fetches operand and increments PC
-// TODO: inline these
-u8 Processor::GetOperand8()
+// ADD/ADC/SUB/SBC/AND/XOR/OR/CP A, r; 0x80-0xBF
+template<u8 opcode>
+int Processor::OpALU()
 {
-    return memory_bus->Read8(reg_PC.word++);
+    u8 value = GetR8<opcode & 7>();
+    switch((opcode >> 3) & 7)
+    {
+    case 0: add(reg_A, value); break;
+    case 1: adc(reg_A, value); break;
+    case 2: sub(reg_A, value); break;
+    case 3: sbc(reg_A, value); break;
+    case 4: and8(reg_A, value); break;
+    case 5: xor8(reg_A, value); break;
+    case 6: or8(reg_A, value); break;
+    case 7: cp(value); break;
+    }
+    return Cycles(opcode);
 }
 
-u16 Processor::GetOperand16()
+// Opcodes without a specialization below are either in one of the
+// register blocks above or undefined on the SM83
+template<u8 opcode>
+int Processor::Op()
 {
-    u16 operand = memory_bus->Read16(reg_PC.word);
-    reg_PC.word += 2;
-    return operand;
+    if(opcode >= 0x40 && opcode < 0x80)
+        return OpLoad<opcode>();
+    if(opcode >= 0x80 && opcode < 0xC0)
+        return OpALU<opcode>();
+
+    Debug::Logger::LogDisassembly(memory_bus, reg_PC.word - 1, 1);
+    LOG_ERROR("Unknown opcode!");
+    gameboy->Stop();
+    return Cycles(opcode);
 }
 
-// Decodes and executes instruction
-int Processor::ExecuteNext()
+template<u8 opcode>
+int Processor::OpCB()
 {
-    u8 opcode = memory_bus->Read8(reg_PC.word++);
-    bool branch_taken = false;
-    // the table to look for opcode information in
-    const Opcode* opcode_lookup_table = OPCODE_LOOKUP;
+    Debug::Logger::LogDisassembly(memory_bus, reg_PC.word - 2, 1);
+    LOG_ERROR("Unknown extended opcode!");
+    gameboy->Stop();
+    return CBCycles(opcode);
+}
+
+// CB opcode handlers
+
+// RLC reg8
+template<> int Processor::OpCB<0x00>() { rlc(reg_B, true); return CBCycles(0x00); }
+template<> int Processor::OpCB<0x01>() { rlc(reg_C, true); return CBCycles(0x01); }
+template<> int Processor::OpCB<0x02>() { rlc(reg_D, true); return CBCycles(0x02); }
+template<> int Processor::OpCB<0x03>() { rlc(reg_E, true); return CBCycles(0x03); }
+template<> int Processor::OpCB<0x04>() { rlc(reg_H, true); return CBCycles(0x04); }
+template<> int Processor::OpCB<0x05>() { rlc(reg_L, true); return CBCycles(0x05); }
+template<> int Processor::OpCB<0x06>() { rlcAt(reg_HL.word, true); return CBCycles(0x06); }
+template<> int Processor::OpCB<0x07>() { rlc(reg_A, true); return CBCycles(0x07); }
+
+// RL reg8
+template<> int Processor::OpCB<0x10>() { rl(reg_B, true); return CBCycles(0x10); }
+template<> int Processor::OpCB<0x11>() { rl(reg_C, true); return CBCycles(0x11); }
+template<> int Processor::OpCB<0x12>() { rl(reg_D, true); return CBCycles(0x12); }
+template<> int Processor::OpCB<0x13>() { rl(reg_E, true); return CBCycles(0x13); }
+template<> int Processor::OpCB<0x14>() { rl(reg_H, true); return CBCycles(0x14); }
+template<> int Processor::OpCB<0x15>() { rl(reg_L, true); return CBCycles(0x15); }
+template<> int Processor::OpCB<0x16>() { rlAt(reg_HL.word, true); return CBCycles(0x16); }
+template<> int Processor::OpCB<0x17>() { rl(reg_A, true); return CBCycles(0x17); }
+
+// RRC reg8
+template<> int Processor::OpCB<0x08>() { rrc(reg_B, true); return CBCycles(0x08); }
+template<> int Processor::OpCB<0x09>() { rrc(reg_C, true); return CBCycles(0x09); }
+template<> int Processor::OpCB<0x0A>() { rrc(reg_D, true); return CBCycles(0x0A); }
+template<> int Processor::OpCB<0x0B>() { rrc(reg_E, true); return CBCycles(0x0B); }
+template<> int Processor::OpCB<0x0C>() { rrc(reg_H, true); return CBCycles(0x0C); }
+template<> int Processor::OpCB<0x0D>() { rrc(reg_L, true); return CBCycles(0x0D); }
+template<> int Processor::OpCB<0x0E>() { rrcAt(reg_HL.word, true); return CBCycles(0x0E); }
+template<> int Processor::OpCB<0x0F>() { rrc(reg_A, true); return CBCycles(0x0F); }
+
+// RR reg8
+template<> int Processor::OpCB<0x18>() { rr(reg_B, true); return CBCycles(0x18); }
+template<> int Processor::OpCB<0x19>() { rr(reg_C, true); return CBCycles(0x19); }
+template<> int Processor::OpCB<0x1A>() { rr(reg_D, true); return CBCycles(0x1A); }
+template<> int Processor::OpCB<0x1B>() { rr(reg_E, true); return CBCycles(0x1B); }
+template<> int Processor::OpCB<0x1C>() { rr(reg_H, true); return CBCycles(0x1C); }
+template<> int Processor::OpCB<0x1D>() { rr(reg_L, true); return CBCycles(0x1D); }
+template<> int Processor::OpCB<0x1E>() { rrAt(reg_HL.word, true); return CBCycles(0x1E); }
+template<> int Processor::OpCB<0x1F>() { rr(reg_A, true); return CBCycles(0x1F); }
+
+// SLA reg8
+template<> int Processor::OpCB<0x20>() { sla(reg_B); return CBCycles(0x20); }
+template<> int Processor::OpCB<0x21>() { sla(reg_C); return CBCycles(0x21); }
+template<> int Processor::OpCB<0x22>() { sla(reg_D); return CBCycles(0x22); }
+template<> int Processor::OpCB<0x23>() { sla(reg_E); return CBCycles(0x23); }
+template<> int Processor::OpCB<0x24>() { sla(reg_H); return CBCycles(0x24); }
+template<> int Processor::OpCB<0x25>() { sla(reg_L); return CBCycles(0x25); }
+template<> int Processor::OpCB<0x26>() { slaAt(reg_HL.word); return CBCycles(0x26); }
+template<> int Processor::OpCB<0x27>() { sla(reg_A); return CBCycles(0x27); }
+
+// SRA reg8
+template<> int Processor::OpCB<0x28>() { sra(reg_B); return CBCycles(0x28); }
+template<> int Processor::OpCB<0x29>() { sra(reg_C); return CBCycles(0x29); }
+template<> int Processor::OpCB<0x2A>() { sra(reg_D); return CBCycles(0x2A); }
+template<> int Processor::OpCB<0x2B>() { sra(reg_E); return CBCycles(0x2B); }
+template<> int Processor::OpCB<0x2C>() { sra(reg_H); return CBCycles(0x2C); }
+template<> int Processor::OpCB<0x2D>() { sra(reg_L); return CBCycles(0x2D); }
+template<> int Processor::OpCB<0x2E>() { sraAt(reg_HL.word); return CBCycles(0x2E); }
+template<> int Processor::OpCB<0x2F>() { sra(reg_A); return CBCycles(0x2F); }
+
+// SWAP reg8
+template<> int Processor::OpCB<0x30>() { swap(reg_B); return CBCycles(0x30); }
+template<> int Processor::OpCB<0x31>() { swap(reg_C); return CBCycles(0x31); }
+template<> int Processor::OpCB<0x32>() { swap(reg_D); return CBCycles(0x32); }
+template<> int Processor::OpCB<0x33>() { swap(reg_E); return CBCycles(0x33); }
+template<> int Processor::OpCB<0x34>() { swap(reg_H); return CBCycles(0x34); }
+template<> int Processor::OpCB<0x35>() { swap(reg_L); return CBCycles(0x35); }
+template<> int Processor::OpCB<0x36>() { swapAt(reg_HL.word); return CBCycles(0x36); }
+template<> int Processor::OpCB<0x37>() { swap(reg_A); return CBCycles(0x37); }
+
+// SRL reg8
+template<> int Processor::OpCB<0x38>() { srl(reg_B); return CBCycles(0x38); }
+template<> int Processor::OpCB<0x39>() { srl(reg_C); return CBCycles(0x39); }
+template<> int Processor::OpCB<0x3A>() { srl(reg_D); return CBCycles(0x3A); }
+template<> int Processor::OpCB<0x3B>() { srl(reg_E); return CBCycles(0x3B); }
+template<> int Processor::OpCB<0x3C>() { srl(reg_H); return CBCycles(0x3C); }
+template<> int Processor::OpCB<0x3D>() { srl(reg_L); return CBCycles(0x3D); }
+template<> int Processor::OpCB<0x3E>() { srlAt(reg_HL.word); return CBCycles(0x3E); }
+template<> int Processor::OpCB<0x3F>() { srl(reg_A); return CBCycles(0x3F); }
+
+// BIT x, u8
+template<> int Processor::OpCB<0x40>() { bit(reg_B, 0); return CBCycles(0x40); }
+template<> int Processor::OpCB<0x41>() { bit(reg_C, 0); return CBCycles(0x41); }
+template<> int Processor::OpCB<0x42>() { bit(reg_D, 0); return CBCycles(0x42); }
+template<> int Processor::OpCB<0x43>() { bit(reg_E, 0); return CBCycles(0x43); }
+template<> int Processor::OpCB<0x44>() { bit(reg_H, 0); return CBCycles(0x44); }
+template<> int Processor::OpCB<0x45>() { bit(reg_L, 0); return CBCycles(0x45); }
+template<> int Processor::OpCB<0x46>() { bit(memory_bus->Read8(reg_HL.word), 0); return CBCycles(0x46); }
+template<> int Processor::OpCB<0x47>() { bit(reg_A, 0); return CBCycles(0x47); }
+template<> int Processor::OpCB<0x48>() { bit(reg_B, 1); return CBCycles(0x48); }
+template<> int Processor::OpCB<0x49>() { bit(reg_C, 1); return CBCycles(0x49); }
+template<> int Processor::OpCB<0x4A>() { bit(reg_D, 1); return CBCycles(0x4A); }
+template<> int Processor::OpCB<0x4B>() { bit(reg_E, 1); return CBCycles(0x4B); }
+template<> int Processor::OpCB<0x4C>() { bit(reg_H, 1); return CBCycles(0x4C); }
+template<> int Processor::OpCB<0x4D>() { bit(reg_L, 1); return CBCycles(0x4D); }
+template<> int Processor::OpCB<0x4E>() { bit(memory_bus->Read8(reg_HL.word), 1); return CBCycles(0x4E); }
+template<> int Processor::OpCB<0x4F>() { bit(reg_A, 1); return CBCycles(0x4F); }
+template<> int Processor::OpCB<0x50>() { bit(reg_B, 2); return CBCycles(0x50); }
+template<> int Processor::OpCB<0x51>() { bit(reg_C, 2); return CBCycles(0x51); }
+template<> int Processor::OpCB<0x52>() { bit(reg_D, 2); return CBCycles(0x52); }
+template<> int Processor::OpCB<0x53>() { bit(reg_E, 2); return CBCycles(0x53); }
+template<> int Processor::OpCB<0x54>() { bit(reg_H, 2); return CBCycles(0x54); }
+template<> int Processor::OpCB<0x55>() { bit(reg_L, 2); return CBCycles(0x55); }
+template<> int Processor::OpCB<0x56>() { bit(memory_bus->Read8(reg_HL.word), 2); return CBCycles(0x56); }
+template<> int Processor::OpCB<0x57>() { bit(reg_A, 2); return CBCycles(0x57); }
+template<> int Processor::OpCB<0x58>() { bit(reg_B, 3); return CBCycles(0x58); }
+template<> int Processor::OpCB<0x59>() { bit(reg_C, 3); return CBCycles(0x59); }
+template<> int Processor::OpCB<0x5A>() { bit(reg_D, 3); return CBCycles(0x5A); }
+template<> int Processor::OpCB<0x5B>() { bit(reg_E, 3); return CBCycles(0x5B); }
+template<> int Processor::OpCB<0x5C>() { bit(reg_H, 3); return CBCycles(0x5C); }
+template<> int Processor::OpCB<0x5D>() { bit(reg_L, 3); return CBCycles(0x5D); }
+template<> int Processor::OpCB<0x5E>() { bit(memory_bus->Read8(reg_HL.word), 3); return CBCycles(0x5E); }
+template<> int Processor::OpCB<0x5F>() { bit(reg_A, 3); return CBCycles(0x5F); }
+template<> int Processor::OpCB<0x60>() { bit(reg_B, 4); return CBCycles(0x60); }
+template<> int Processor::OpCB<0x61>() { bit(reg_C, 4); return CBCycles(0x61); }
+template<> int Processor::OpCB<0x62>() { bit(reg_D, 4); return CBCycles(0x62); }
+template<> int Processor::OpCB<0x63>() { bit(reg_E, 4); return CBCycles(0x63); }
+template<> int Processor::OpCB<0x64>() { bit(reg_H, 4); return CBCycles(0x64); }
+template<> int Processor::OpCB<0x65>() { bit(reg_L, 4); return CBCycles(0x65); }
+template<> int Processor::OpCB<0x66>() { bit(memory_bus->Read8(reg_HL.word), 4); return CBCycles(0x66); }
+template<> int Processor::OpCB<0x67>() { bit(reg_A, 4); return CBCycles(0x67); }
+template<> int Processor::OpCB<0x68>() { bit(reg_B, 5); return CBCycles(0x68); }
+template<> int Processor::OpCB<0x69>() { bit(reg_C, 5); return CBCycles(0x69); }
+template<> int Processor::OpCB<0x6A>() { bit(reg_D, 5); return CBCycles(0x6A); }
+template<> int Processor::OpCB<0x6B>() { bit(reg_E, 5); return CBCycles(0x6B); }
+template<> int Processor::OpCB<0x6C>() { bit(reg_H, 5); return CBCycles(0x6C); }
+template<> int Processor::OpCB<0x6D>() { bit(reg_L, 5); return CBCycles(0x6D); }
+template<> int Processor::OpCB<0x6E>() { bit(memory_bus->Read8(reg_HL.word), 5); return CBCycles(0x6E); }
+template<> int Processor::OpCB<0x6F>() { bit(reg_A, 5); return CBCycles(0x6F); }
+template<> int Processor::OpCB<0x70>() { bit(reg_B, 6); return CBCycles(0x70); }
+template<> int Processor::OpCB<0x71>() { bit(reg_C, 6); return CBCycles(0x71); }
+template<> int Processor::OpCB<0x72>() { bit(reg_D, 6); return CBCycles(0x72); }
+template<> int Processor::OpCB<0x73>() { bit(reg_E, 6); return CBCycles(0x73); }
+template<> int Processor::OpCB<0x74>() { bit(reg_H, 6); return CBCycles(0x74); }
+template<> int Processor::OpCB<0x75>() { bit(reg_L, 6); return CBCycles(0x75); }
+template<> int Processor::OpCB<0x76>() { bit(memory_bus->Read8(reg_HL.word), 6); return CBCycles(0x76); }
+template<> int Processor::OpCB<0x77>() { bit(reg_A, 6); return CBCycles(0x77); }
+template<> int Processor::OpCB<0x78>() { bit(reg_B, 7); return CBCycles(0x78); }
+template<> int Processor::OpCB<0x79>() { bit(reg_C, 7); return CBCycles(0x79); }
+template<> int Processor::OpCB<0x7A>() { bit(reg_D, 7); return CBCycles(0x7A); }
+template<> int Processor::OpCB<0x7B>() { bit(reg_E, 7); return CBCycles(0x7B); }
+template<> int Processor::OpCB<0x7C>() { bit(reg_H, 7); return CBCycles(0x7C); }
+template<> int Processor::OpCB<0x7D>() { bit(reg_L, 7); return CBCycles(0x7D); }
+template<> int Processor::OpCB<0x7E>() { bit(memory_bus->Read8(reg_HL.word), 7); return CBCycles(0x7E); }
+template<> int Processor::OpCB<0x7F>() { bit(reg_A, 7); return CBCycles(0x7F); }
+
+// RES x, reg8
+template<> int Processor::OpCB<0x80>() { res(reg_B, 0); return CBCycles(0x80); }
+template<> int Processor::OpCB<0x81>() { res(reg_C, 0); return CBCycles(0x81); }
+template<> int Processor::OpCB<0x82>() { res(reg_D, 0); return CBCycles(0x82); }
+template<> int Processor::OpCB<0x83>() { res(reg_E, 0); return CBCycles(0x83); }
+template<> int Processor::OpCB<0x84>() { res(reg_H, 0); return CBCycles(0x84); }
+template<> int Processor::OpCB<0x85>() { res(reg_L, 0); return CBCycles(0x85); }
+template<> int Processor::OpCB<0x86>() { resAt(reg_HL.word, 0); return CBCycles(0x86); }
+template<> int Processor::OpCB<0x87>() { res(reg_A, 0); return CBCycles(0x87); }
+template<> int Processor::OpCB<0x88>() { res(reg_B, 1); return CBCycles(0x88); }
+template<> int Processor::OpCB<0x89>() { res(reg_C, 1); return CBCycles(0x89); }
+template<> int Processor::OpCB<0x8A>() { res(reg_D, 1); return CBCycles(0x8A); }
+template<> int Processor::OpCB<0x8B>() { res(reg_E, 1); return CBCycles(0x8B); }
+template<> int Processor::OpCB<0x8C>() { res(reg_H, 1); return CBCycles(0x8C); }
+template<> int Processor::OpCB<0x8D>() { res(reg_L, 1); return CBCycles(0x8D); }
+template<> int Processor::OpCB<0x8E>() { resAt(reg_HL.word, 1); return CBCycles(0x8E); }
+template<> int Processor::OpCB<0x8F>() { res(reg_A, 1); return CBCycles(0x8F); }
+template<> int Processor::OpCB<0x90>() { res(reg_B, 2); return CBCycles(0x90); }
+template<> int Processor::OpCB<0x91>() { res(reg_C, 2); return CBCycles(0x91); }
+template<> int Processor::OpCB<0x92>() { res(reg_D, 2); return CBCycles(0x92); }
+template<> int Processor::OpCB<0x93>() { res(reg_E, 2); return CBCycles(0x93); }
+template<> int Processor::OpCB<0x94>() { res(reg_H, 2); return CBCycles(0x94); }
+template<> int Processor::OpCB<0x95>() { res(reg_L, 2); return CBCycles(0x95); }
+template<> int Processor::OpCB<0x96>() { resAt(reg_HL.word, 2); return CBCycles(0x96); }
+template<> int Processor::OpCB<0x97>() { res(reg_A, 2); return CBCycles(0x97); }
+template<> int Processor::OpCB<0x98>() { res(reg_B, 3); return CBCycles(0x98); }
+template<> int Processor::OpCB<0x99>() { res(reg_C, 3); return CBCycles(0x99); }
+template<> int Processor::OpCB<0x9A>() { res(reg_D, 3); return CBCycles(0x9A); }
+template<> int Processor::OpCB<0x9B>() { res(reg_E, 3); return CBCycles(0x9B); }
+template<> int Processor::OpCB<0x9C>() { res(reg_H, 3); return CBCycles(0x9C); }
+template<> int Processor::OpCB<0x9D>() { res(reg_L, 3); return CBCycles(0x9D); }
+template<> int Processor::OpCB<0x9E>() { resAt(reg_HL.word, 3); return CBCycles(0x9E); }
+template<> int Processor::OpCB<0x9F>() { res(reg_A, 3); return CBCycles(0x9F); }
+template<> int Processor::OpCB<0xA0>() { res(reg_B, 4); return CBCycles(0xA0); }
+template<> int Processor::OpCB<0xA1>() { res(reg_C, 4); return CBCycles(0xA1); }
+template<> int Processor::OpCB<0xA2>() { res(reg_D, 4); return CBCycles(0xA2); }
+template<> int Processor::OpCB<0xA3>() { res(reg_E, 4); return CBCycles(0xA3); }
+template<> int Processor::OpCB<0xA4>() { res(reg_H, 4); return CBCycles(0xA4); }
+template<> int Processor::OpCB<0xA5>() { res(reg_L, 4); return CBCycles(0xA5); }
+template<> int Processor::OpCB<0xA6>() { resAt(reg_HL.word, 4); return CBCycles(0xA6); }
+template<> int Processor::OpCB<0xA7>() { res(reg_A, 4); return CBCycles(0xA7); }
+template<> int Processor::OpCB<0xA8>() { res(reg_B, 5); return CBCycles(0xA8); }
+template<> int Processor::OpCB<0xA9>() { res(reg_C, 5); return CBCycles(0xA9); }
+template<> int Processor::OpCB<0xAA>() { res(reg_D, 5); return CBCycles(0xAA); }
+template<> int Processor::OpCB<0xAB>() { res(reg_E, 5); return CBCycles(0xAB); }
+template<> int Processor::OpCB<0xAC>() { res(reg_H, 5); return CBCycles(0xAC); }
+template<> int Processor::OpCB<0xAD>() { res(reg_L, 5); return CBCycles(0xAD); }
+template<> int Processor::OpCB<0xAE>() { resAt(reg_HL.word, 5); return CBCycles(0xAE); }
+template<> int Processor::OpCB<0xAF>() { res(reg_A, 5); return CBCycles(0xAF); }
+template<> int Processor::OpCB<0xB0>() { res(reg_B, 6); return CBCycles(0xB0); }
+template<> int Processor::OpCB<0xB1>() { res(reg_C, 6); return CBCycles(0xB1); }
+template<> int Processor::OpCB<0xB2>() { res(reg_D, 6); return CBCycles(0xB2); }
+template<> int Processor::OpCB<0xB3>() { res(reg_E, 6); return CBCycles(0xB3); }
+template<> int Processor::OpCB<0xB4>() { res(reg_H, 6); return CBCycles(0xB4); }
+template<> int Processor::OpCB<0xB5>() { res(reg_L, 6); return CBCycles(0xB5); }
+template<> int Processor::OpCB<0xB6>() { resAt(reg_HL.word, 6); return CBCycles(0xB6); }
+template<> int Processor::OpCB<0xB7>() { res(reg_A, 6); return CBCycles(0xB7); }
+template<> int Processor::OpCB<0xB8>() { res(reg_B, 7); return CBCycles(0xB8); }
+template<> int Processor::OpCB<0xB9>() { res(reg_C, 7); return CBCycles(0xB9); }
+template<> int Processor::OpCB<0xBA>() { res(reg_D, 7); return CBCycles(0xBA); }
+template<> int Processor::OpCB<0xBB>() { res(reg_E, 7); return CBCycles(0xBB); }
+template<> int Processor::OpCB<0xBC>() { res(reg_H, 7); return CBCycles(0xBC); }
+template<> int Processor::OpCB<0xBD>() { res(reg_L, 7); return CBCycles(0xBD); }
+template<> int Processor::OpCB<0xBE>() { resAt(reg_HL.word, 7); return CBCycles(0xBE); }
+template<> int Processor::OpCB<0xBF>() { res(reg_A, 7); return CBCycles(0xBF); }
+
+// SET x, reg8
+template<> int Processor::OpCB<0xC0>() { set(reg_B, 0); return CBCycles(0xC0); }
+template<> int Processor::OpCB<0xC1>() { set(reg_C, 0); return CBCycles(0xC1); }
+template<> int Processor::OpCB<0xC2>() { set(reg_D, 0); return CBCycles(0xC2); }
+template<> int Processor::OpCB<0xC3>() { set(reg_E, 0); return CBCycles(0xC3); }
+template<> int Processor::OpCB<0xC4>() { set(reg_H, 0); return CBCycles(0xC4); }
+template<> int Processor::OpCB<0xC5>() { set(reg_L, 0); return CBCycles(0xC5); }
+template<> int Processor::OpCB<0xC6>() { setAt(reg_HL.word, 0); return CBCycles(0xC6); }
+template<> int Processor::OpCB<0xC7>() { set(reg_A, 0); return CBCycles(0xC7); }
+template<> int Processor::OpCB<0xC8>() { set(reg_B, 1); return CBCycles(0xC8); }
+template<> int Processor::OpCB<0xC9>() { set(reg_C, 1); return CBCycles(0xC9); }
+template<> int Processor::OpCB<0xCA>() { set(reg_D, 1); return CBCycles(0xCA); }
+template<> int Processor::OpCB<0xCB>() { set(reg_E, 1); return CBCycles(0xCB); }
+template<> int Processor::OpCB<0xCC>() { set(reg_H, 1); return CBCycles(0xCC); }
+template<> int Processor::OpCB<0xCD>() { set(reg_L, 1); return CBCycles(0xCD); }
+template<> int Processor::OpCB<0xCE>() { setAt(reg_HL.word, 1); return CBCycles(0xCE); }
+template<> int Processor::OpCB<0xCF>() { set(reg_A, 1); return CBCycles(0xCF); }
+template<> int Processor::OpCB<0xD0>() { set(reg_B, 2); return CBCycles(0xD0); }
+template<> int Processor::OpCB<0xD1>() { set(reg_C, 2); return CBCycles(0xD1); }
+template<> int Processor::OpCB<0xD2>() { set(reg_D, 2); return CBCycles(0xD2); }
+template<> int Processor::OpCB<0xD3>() { set(reg_E, 2); return CBCycles(0xD3); }
+template<> int Processor::OpCB<0xD4>() { set(reg_H, 2); return CBCycles(0xD4); }
+template<> int Processor::OpCB<0xD5>() { set(reg_L, 2); return CBCycles(0xD5); }
+template<> int Processor::OpCB<0xD6>() { setAt(reg_HL.word, 2); return CBCycles(0xD6); }
+template<> int Processor::OpCB<0xD7>() { set(reg_A, 2); return CBCycles(0xD7); }
+template<> int Processor::OpCB<0xD8>() { set(reg_B, 3); return CBCycles(0xD8); }
+template<> int Processor::OpCB<0xD9>() { set(reg_C, 3); return CBCycles(0xD9); }
+template<> int Processor::OpCB<0xDA>() { set(reg_D, 3); return CBCycles(0xDA); }
+template<> int Processor::OpCB<0xDB>() { set(reg_E, 3); return CBCycles(0xDB); }
+template<> int Processor::OpCB<0xDC>() { set(reg_H, 3); return CBCycles(0xDC); }
+template<> int Processor::OpCB<0xDD>() { set(reg_L, 3); return CBCycles(0xDD); }
+template<> int Processor::OpCB<0xDE>() { setAt(reg_HL.word, 3); return CBCycles(0xDE); }
+template<> int Processor::OpCB<0xDF>() { set(reg_A, 3); return CBCycles(0xDF); }
+template<> int Processor::OpCB<0xE0>() { set(reg_B, 4); return CBCycles(0xE0); }
+template<> int Processor::OpCB<0xE1>() { set(reg_C, 4); return CBCycles(0xE1); }
+template<> int Processor::OpCB<0xE2>() { set(reg_D, 4); return CBCycles(0xE2); }
+template<> int Processor::OpCB<0xE3>() { set(reg_E, 4); return CBCycles(0xE3); }
+template<> int Processor::OpCB<0xE4>() { set(reg_H, 4); return CBCycles(0xE4); }
+template<> int Processor::OpCB<0xE5>() { set(reg_L, 4); return CBCycles(0xE5); }
+template<> int Processor::OpCB<0xE6>() { setAt(reg_HL.word, 4); return CBCycles(0xE6); }
+template<> int Processor::OpCB<0xE7>() { set(reg_A, 4); return CBCycles(0xE7); }
+template<> int Processor::OpCB<0xE8>() { set(reg_B, 5); return CBCycles(0xE8); }
+template<> int Processor::OpCB<0xE9>() { set(reg_C, 5); return CBCycles(0xE9); }
+template<> int Processor::OpCB<0xEA>() { set(reg_D, 5); return CBCycles(0xEA); }
+template<> int Processor::OpCB<0xEB>() { set(reg_E, 5); return CBCycles(0xEB); }
+template<> int Processor::OpCB<0xEC>() { set(reg_H, 5); return CBCycles(0xEC); }
+template<> int Processor::OpCB<0xED>() { set(reg_L, 5); return CBCycles(0xED); }
+template<> int Processor::OpCB<0xEE>() { setAt(reg_HL.word, 5); return CBCycles(0xEE); }
+template<> int Processor::OpCB<0xEF>() { set(reg_A, 5); return CBCycles(0xEF); }
+template<> int Processor::OpCB<0xF0>() { set(reg_B, 6); return CBCycles(0xF0); }
+template<> int Processor::OpCB<0xF1>() { set(reg_C, 6); return CBCycles(0xF1); }
+template<> int Processor::OpCB<0xF2>() { set(reg_D, 6); return CBCycles(0xF2); }
+template<> int Processor::OpCB<0xF3>() { set(reg_E, 6); return CBCycles(0xF3); }
+template<> int Processor::OpCB<0xF4>() { set(reg_H, 6); return CBCycles(0xF4); }
+template<> int Processor::OpCB<0xF5>() { set(reg_L, 6); return CBCycles(0xF5); }
+template<> int Processor::OpCB<0xF6>() { setAt(reg_HL.word, 6); return CBCycles(0xF6); }
+template<> int Processor::OpCB<0xF7>() { set(reg_A, 6); return CBCycles(0xF7); }
+template<> int Processor::OpCB<0xF8>() { set(reg_B, 7); return CBCycles(0xF8); }
+template<> int Processor::OpCB<0xF9>() { set(reg_C, 7); return CBCycles(0xF9); }
+template<> int Processor::OpCB<0xFA>() { set(reg_D, 7); return CBCycles(0xFA); }
+template<> int Processor::OpCB<0xFB>() { set(reg_E, 7); return CBCycles(0xFB); }
+template<> int Processor::OpCB<0xFC>() { set(reg_H, 7); return CBCycles(0xFC); }
+template<> int Processor::OpCB<0xFD>() { set(reg_L, 7); return CBCycles(0xFD); }
+template<> int Processor::OpCB<0xFE>() { setAt(reg_HL.word, 7); return CBCycles(0xFE); }
+template<> int Processor::OpCB<0xFF>() { set(reg_A, 7); return CBCycles(0xFF); }
+
+// Opcode handlers
+
+// NOP
+template<> int Processor::Op<0x00>() { return Cycles(0x00); }
+// STOP
+template<> int Processor::Op<0x10>() { return Cycles(0x10); }
+// HALT
+template<> int Processor::Op<0x76>()
+{
+    // With IME off and an interrupt already pending the CPU doesn't
+    // halt, and fails to advance PC past the next opcode instead
+    if(!IME && (IE & IF & 0x1F))
+        halt_bug = true;
+    else
+        halted = true;
+    return Cycles(0x76);
+}
+// DI
+template<> int Processor::Op<0xF3>() { IME = false; return Cycles(0xF3); }
+// EI
+template<> int Processor::Op<0xFB>() { IME = true; return Cycles(0xFB); }
+
+// LD reg8, u8
+template<> int Processor::Op<0x06>() { ld(reg_B, Operand8()); return Cycles(0x06); }
+template<> int Processor::Op<0x0E>() { ld(reg_C, Operand8()); return Cycles(0x0E); }
+template<> int Processor::Op<0x16>() { ld(reg_D, Operand8()); return Cycles(0x16); }
+template<> int Processor::Op<0x1E>() { ld(reg_E, Operand8()); return Cycles(0x1E); }
+template<> int Processor::Op<0x26>() { ld(reg_H, Operand8()); return Cycles(0x26); }
+template<> int Processor::Op<0x2E>() { ld(reg_L, Operand8()); return Cycles(0x2E); }
+template<> int Processor::Op<0x3E>() { ld(reg_A, Operand8()); return Cycles(0x3E); }
+template<> int Processor::Op<0x0A>() { ld(reg_A, memory_bus->Read8(reg_BC.word)); return Cycles(0x0A); }
+template<> int Processor::Op<0x1A>() { ld(reg_A, memory_bus->Read8(reg_DE.word)); return Cycles(0x1A); }
+template<> int Processor::Op<0x2A>() { ld(reg_A, memory_bus->Read8(reg_HL.word++)); return Cycles(0x2A); }
+template<> int Processor::Op<0x3A>() { ld(reg_A, memory_bus->Read8(reg_HL.word--)); return Cycles(0x3A); }
+template<> int Processor::Op<0xF0>() { ld(reg_A, memory_bus->Read8(0xFF00 + Operand8())); return Cycles(0xF0); }
+template<> int Processor::Op<0xF2>() { ld(reg_A, memory_bus->Read8(0xFF00 + reg_C)); return Cycles(0xF2); }
+template<> int Processor::Op<0xFA>() { ld(reg_A, memory_bus->Read8(Operand16())); return Cycles(0xFA); }
+// LD reg16, u16
+template<> int Processor::Op<0x01>() { ld(reg_BC, Operand16()); return Cycles(0x01); }
+template<> int Processor::Op<0x11>() { ld(reg_DE, Operand16()); return Cycles(0x11); }
+template<> int Processor::Op<0x21>() { ld(reg_HL, Operand16()); return Cycles(0x21); }
+template<> int Processor::Op<0x31>() { ld(reg_SP, Operand16()); return Cycles(0x31); }
+template<> int Processor::Op<0xF8>() { ld_sp_plus(reg_HL, static_cast<s8>(Operand8())); return Cycles(0xF8); }
+template<> int Processor::Op<0xF9>() { ld(reg_SP, reg_HL.word); return Cycles(0xF9); }
+
+// LD (addr), u8
+template<> int Processor::Op<0x02>() { ldAt(reg_BC.word, reg_A); return Cycles(0x02); }
+template<> int Processor::Op<0x12>() { ldAt(reg_DE.word, reg_A); return Cycles(0x12); }
+template<> int Processor::Op<0x22>() { ldAt(reg_HL.word++, reg_A); return Cycles(0x22); }
+template<> int Processor::Op<0x32>() { ldAt(reg_HL.word--, reg_A); return Cycles(0x32); }
+template<> int Processor::Op<0x36>() { ldAt(reg_HL.word, Operand8()); return Cycles(0x36); }
+template<> int Processor::Op<0xE0>() { ldAt(0xFF00 + Operand8(), reg_A); return Cycles(0xE0); }
+template<> int Processor::Op<0xE2>() { ldAt(0xFF00 + reg_C, reg_A); return Cycles(0xE2); }
+template<> int Processor::Op<0xEA>() { ldAt(Operand16(), reg_A); return Cycles(0xEA); }
+// LD (addr), u16
+template<> int Processor::Op<0x08>() { ldAt(Operand16(), reg_SP.word); return Cycles(0x08); }
+
+// INC reg8
+template<> int Processor::Op<0x04>() { inc(reg_B); return Cycles(0x04); }
+template<> int Processor::Op<0x0C>() { inc(reg_C); return Cycles(0x0C); }
+template<> int Processor::Op<0x14>() { inc(reg_D); return Cycles(0x14); }
+template<> int Processor::Op<0x1C>() { inc(reg_E); return Cycles(0x1C); }
+template<> int Processor::Op<0x24>() { inc(reg_H); return Cycles(0x24); }
+template<> int Processor::Op<0x2C>() { inc(reg_L); return Cycles(0x2C); }
+template<> int Processor::Op<0x3C>() { inc(reg_A); return Cycles(0x3C); }
+// INC reg16
+template<> int Processor::Op<0x03>() { inc(reg_BC); return Cycles(0x03); }
+template<> int Processor::Op<0x13>() { inc(reg_DE); return Cycles(0x13); }
+template<> int Processor::Op<0x23>() { inc(reg_HL); return Cycles(0x23); }
+template<> int Processor::Op<0x33>() { inc(reg_SP); return Cycles(0x33); }
+// INC (HL)
+template<> int Processor::Op<0x34>() { incAt(reg_HL.word); return Cycles(0x34); }
+
+// DEC reg8
+template<> int Processor::Op<0x05>() { dec(reg_B); return Cycles(0x05); }
+template<> int Processor::Op<0x0D>() { dec(reg_C); return Cycles(0x0D); }
+template<> int Processor::Op<0x15>() { dec(reg_D); return Cycles(0x15); }
+template<> int Processor::Op<0x1D>() { dec(reg_E); return Cycles(0x1D); }
+template<> int Processor::Op<0x25>() { dec(reg_H); return Cycles(0x25); }
+template<> int Processor::Op<0x2D>() { dec(reg_L); return Cycles(0x2D); }
+template<> int Processor::Op<0x3D>() { dec(reg_A); return Cycles(0x3D); }
+// DEC reg16
+template<> int Processor::Op<0x0B>() { dec(reg_BC); return Cycles(0x0B); }
+template<> int Processor::Op<0x1B>() { dec(reg_DE); return Cycles(0x1B); }
+template<> int Processor::Op<0x2B>() { dec(reg_HL); return Cycles(0x2B); }
+template<> int Processor::Op<0x3B>() { dec(reg_SP); return Cycles(0x3B); }
+// DEC (HL)
+template<> int Processor::Op<0x35>() { decAt(reg_HL.word); return Cycles(0x35); }
+
+// ADD reg8, u8
+template<> int Processor::Op<0xC6>() { add(reg_A, Operand8()); return Cycles(0xC6); }
+// ADD reg16, u16
+template<> int Processor::Op<0x09>() { add(reg_HL, reg_BC.word); return Cycles(0x09); }
+template<> int Processor::Op<0x19>() { add(reg_HL, reg_DE.word); return Cycles(0x19); }
+template<> int Processor::Op<0x29>() { add(reg_HL, reg_HL.word); return Cycles(0x29); }
+template<> int Processor::Op<0x39>() { add(reg_HL, reg_SP.word); return Cycles(0x39); }
+// ADD reg16, s8
+template<> int Processor::Op<0xE8>() { add(reg_SP, static_cast<s8>(Operand8())); return Cycles(0xE8); }
+
+// ADC reg8, u8
+template<> int Processor::Op<0xCE>() { adc(reg_A, Operand8()); return Cycles(0xCE); }
+
+// SUB reg8, u8
+template<> int Processor::Op<0xD6>() { sub(reg_A, Operand8()); return Cycles(0xD6); }
+
+// SBC reg8, u8
+template<> int Processor::Op<0xDE>() { sbc(reg_A, Operand8()); return Cycles(0xDE); }
+
+// AND reg8, u8
+template<> int Processor::Op<0xE6>() { and8(reg_A, Operand8()); return Cycles(0xE6); }
+
+// XOR reg8, u8
+template<> int Processor::Op<0xEE>() { xor8(reg_A, Operand8()); return Cycles(0xEE); }
+
+// CPL
+template<> int Processor::Op<0x2F>() { cpl(reg_A); return Cycles(0x2F); }
+// CCF
+template<> int Processor::Op<0x3F>() { ccf(); return Cycles(0x3F); }
+// SCF
+template<> int Processor::Op<0x37>() { scf(); return Cycles(0x37); }
+
+// OR reg8, u8
+template<> int Processor::Op<0xF6>() { or8(reg_A, Operand8()); return Cycles(0xF6); }
 
-    if(gameboy->GetOptions().debug) {
-        Debug::Logger::LogDisassembly(memory_bus, reg_PC.word - 1, 1);
-        Debug::Logger::LogRegisters(*this);
+// RLC reg8
+template<> int Processor::Op<0x07>() { rlc(reg_A, false); return Cycles(0x07); }
+// RL reg8
+template<> int Processor::Op<0x17>() { rl(reg_A, false); return Cycles(0x17); }
+// RRC reg8
+template<> int Processor::Op<0x0F>() { rrc(reg_A, false); return Cycles(0x0F); }
+// RR reg8
+template<> int Processor::Op<0x1F>() { rr(reg_A, false); return Cycles(0x1F); }
+
+// DAA
+template<> int Processor::Op<0x27>() { daa(); return Cycles(0x27); }
+
+// CP u8
+template<> int Processor::Op<0xFE>() { cp(Operand8()); return Cycles(0xFE); }
+
+// JR s8
+template<> int Processor::Op<0x18>() { return Cycles(0x18) + jr(static_cast<s8>(Operand8())); }
+template<> int Processor::Op<0x20>()
+{
+    if(!Zero()) {
+        return BranchCycles(0x20) + jr(static_cast<s8>(Operand8()));
     }
+    return Cycles(0x20);
+}
+template<> int Processor::Op<0x28>()
+{
+    if(Zero()) {
+        return BranchCycles(0x28) + jr(static_cast<s8>(Operand8()));
+    }
+    return Cycles(0x28);
+}
+template<> int Processor::Op<0x30>()
+{
+    if(!Carry()) {
+        return BranchCycles(0x30) + jr(static_cast<s8>(Operand8()));
+    }
+    return Cycles(0x30);
+}
+template<> int Processor::Op<0x38>()
+{
+    if(Carry()) {
+        return BranchCycles(0x38) + jr(static_cast<s8>(Operand8()));
+    }
+    return Cycles(0x38);
+}
 
-    switch(opcode)
-    {
-        // CB
-        case 0xCB:
-            opcode_lookup_table = CB_OPCODE_LOOKUP;
-            opcode = ExecuteCBOpcode();
-            break;
-        // NOP
-        case 0x00:
-            break;
-        // STOP
-        case 0x10:
-            break;
-        // HALT
-        case 0x76:
-            break;
-        // DI
-        case 0xF3:
-            IME = false; break;
-        // EI
-        case 0xFB:
-            IME = true; break;
-        
-        // LD reg8, u8
-        case 0x06:
-            ld(reg_B, GetOperand8()); break;
-        case 0x0E:
-            ld(reg_C, GetOperand8()); break;
-        case 0x16:
-            ld(reg_D, GetOperand8()); break;
-        case 0x1E:
-            ld(reg_E, GetOperand8()); break;
-        case 0x26:
-            ld(reg_H, GetOperand8()); break;
-        case 0x2E:
-            ld(reg_L, GetOperand8()); break;
-        case 0x3E:
-            ld(reg_A, GetOperand8()); break;
-        case 0x0A:
-            ld(reg_A, memory_bus->Read8(reg_BC.word)); break;
-        case 0x1A:
-            ld(reg_A, memory_bus->Read8(reg_DE.word)); break;
-        case 0x2A:
-            ld(reg_A, memory_bus->Read8(reg_HL.word++)); break;
-        case 0x3A:
-            ld(reg_A, memory_bus->Read8(reg_HL.word--)); break;
-        case 0x46:
-            ld(reg_B, memory_bus->Read8(reg_HL.word)); break;
-        case 0x4E:
-            ld(reg_C, memory_bus->Read8(reg_HL.word)); break;
-        case 0x56:
-            ld(reg_D, memory_bus->Read8(reg_HL.word)); break;
-        case 0x5E:
-            ld(reg_E, memory_bus->Read8(reg_HL.word)); break;
-        case 0x66:
-            ld(reg_H, memory_bus->Read8(reg_HL.word)); break;
-        case 0x6E:
-            ld(reg_L, memory_bus->Read8(reg_HL.word)); break;
-        case 0x7E:
-            ld(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0xF0:
-            ld(reg_A, memory_bus->Read8(0xFF00 + GetOperand8())); break;
-        case 0xF2:
-            ld(reg_A, memory_bus->Read8(0xFF00 + reg_C)); break;
-        case 0xFA:
-            ld(reg_A, memory_bus->Read8(GetOperand16())); break;
-        case 0x40:
-            ld(reg_B, reg_B); break;
-        case 0x41:
-            ld(reg_B, reg_C); break;
-        case 0x42:
-            ld(reg_B, reg_D); break;
-        case 0x43:
-            ld(reg_B, reg_E); break;
-        case 0x44:
-            ld(reg_B, reg_H); break;
-        case 0x45:
-            ld(reg_B, reg_L); break;
-        case 0x47:
-            ld(reg_B, reg_A); break;
-        case 0x48:
-            ld(reg_C, reg_B); break;
-        case 0x49:
-            ld(reg_C, reg_C); break;
-        case 0x4A:
-            ld(reg_C, reg_D); break;
-        case 0x4B:
-            ld(reg_C, reg_E); break;
-        case 0x4C:
-            ld(reg_C, reg_H); break;
-        case 0x4D:
-            ld(reg_C, reg_L); break;
-        case 0x4F:
-            ld(reg_C, reg_A); break;
-        case 0x50:
-            ld(reg_D, reg_B); break;
-        case 0x51:
-            ld(reg_D, reg_C); break;
-        case 0x52:
-            ld(reg_D, reg_D); break;
-        case 0x53:
-            ld(reg_D, reg_E); break;
-        case 0x54:
-            ld(reg_D, reg_H); break;
-        case 0x55:
-            ld(reg_D, reg_L); break;
-        case 0x57:
-            ld(reg_D, reg_A); break;
-        case 0x58:
-            ld(reg_E, reg_B); break;
-        case 0x59:
-            ld(reg_E, reg_C); break;
-        case 0x5A:
-            ld(reg_E, reg_D); break;
-        case 0x5B:
-            ld(reg_E, reg_E); break;
-        case 0x5C:
-            ld(reg_E, reg_H); break;
-        case 0x5D:
-            ld(reg_E, reg_L); break;
-        case 0x5F:
-            ld(reg_E, reg_A); break;
-        case 0x60:
-            ld(reg_H, reg_B); break;
-        case 0x61:
-            ld(reg_H, reg_C); break;
-        case 0x62:
-            ld(reg_H, reg_D); break;
-        case 0x63:
-            ld(reg_H, reg_E); break;
-        case 0x64:
-            ld(reg_H, reg_H); break;
-        case 0x65:
-            ld(reg_H, reg_L); break;
-        case 0x67:
-            ld(reg_H, reg_A); break;
-        case 0x68:
-            ld(reg_L, reg_B); break;
-        case 0x69:
-            ld(reg_L, reg_C); break;
-        case 0x6A:
-            ld(reg_L, reg_D); break;
-        case 0x6B:
-            ld(reg_L, reg_E); break;
-        case 0x6C:
-            ld(reg_L, reg_H); break;
-        case 0x6D:
-            ld(reg_L, reg_L); break;
-        case 0x6F:
-            ld(reg_L, reg_A); break;
-        case 0x78:
-            ld(reg_A, reg_B); break;
-        case 0x79:
-            ld(reg_A, reg_C); break;
-        case 0x7A:
-            ld(reg_A, reg_D); break;
-        case 0x7B:
-            ld(reg_A, reg_E); break;
-        case 0x7C:
-            ld(reg_A, reg_H); break;
-        case 0x7D:
-            ld(reg_A, reg_L); break;
-        case 0x7F:
-            ld(reg_A, reg_A); break;
-        // LD reg16, u16
-        case 0x01:
-            ld(reg_BC, GetOperand16()); break;
-        case 0x11:
-            ld(reg_DE, GetOperand16()); break;
-        case 0x21:
-            ld(reg_HL, GetOperand16()); break;
-        case 0x31:
-            ld(reg_SP, GetOperand16()); break;
-        case 0xF8:
-            ld_sp_plus(reg_HL, static_cast<s8>(GetOperand8())); break;
-        case 0xF9:
-            ld(reg_SP, reg_HL.word); break;
-
-        // LD (addr), u8
-        case 0x02:
-            ldAt(reg_BC.word, reg_A); break;
-        case 0x12:
-            ldAt(reg_DE.word, reg_A); break;
-        case 0x22:
-            ldAt(reg_HL.word++, reg_A); break;
-        case 0x32:
-            ldAt(reg_HL.word--, reg_A); break;
-        case 0x36:
-            ldAt(reg_HL.word, GetOperand8()); break;
-        case 0x70:
-            ldAt(reg_HL.word, reg_B); break;
-        case 0x71:
-            ldAt(reg_HL.word, reg_C); break;
-        case 0x72:
-            ldAt(reg_HL.word, reg_D); break;
-        case 0x73:
-            ldAt(reg_HL.word, reg_E); break;
-        case 0x74:
-            ldAt(reg_HL.word, reg_H); break;
-        case 0x75:
-            ldAt(reg_HL.word, reg_L); break;
-        case 0x77:
-            ldAt(reg_HL.word, reg_A); break;
-        case 0xE0:
-            ldAt(0xFF00 + GetOperand8(), reg_A); break;
-        case 0xE2:
-            ldAt(0xFF00 + reg_C, reg_A); break;
-        case 0xEA:
-            ldAt(GetOperand16(), reg_A); break;
-        // LD (addr), u16
-        case 0x08:
-            ldAt(GetOperand16(), reg_SP.word); break;
-
-        // INC reg8
-        case 0x04:
-            inc(reg_B); break;
-        case 0x0C:
-            inc(reg_C); break;
-        case 0x14:
-            inc(reg_D); break;
-        case 0x1C:
-            inc(reg_E); break;
-        case 0x24:
-            inc(reg_H); break;
-        case 0x2C:
-            inc(reg_L); break;
-        case 0x3C:
-            inc(reg_A); break;
-        // INC reg16
-        case 0x03:
-            inc(reg_BC); break;
-        case 0x13:
-            inc(reg_DE); break;
-        case 0x23:
-            inc(reg_HL); break;
-        case 0x33:
-            inc(reg_SP); break;
-        // INC (HL)
-        case 0x34:
-            incAt(reg_HL.word); break;
-
-        // DEC reg8
-        case 0x05:
-            dec(reg_B); break;
-        case 0x0D:
-            dec(reg_C); break;
-        case 0x15:
-            dec(reg_D); break;
-        case 0x1D:
-            dec(reg_E); break;
-        case 0x25:
-            dec(reg_H); break;
-        case 0x2D:
-            dec(reg_L); break;
-        case 0x3D:
-            dec(reg_A); break;
-        // DEC reg16
-        case 0x0B:
-            dec(reg_BC); break;
-        case 0x1B:
-            dec(reg_DE); break;
-        case 0x2B:
-            dec(reg_HL); break;
-        case 0x3B:
-            dec(reg_SP); break;
-        // DEC (HL)
-        case 0x35:
-            decAt(reg_HL.word); break;
-
-        // ADD reg8, u8
-        case 0x80:
-            add(reg_A, reg_B); break;
-        case 0x81:
-            add(reg_A, reg_C); break;
-        case 0x82:
-            add(reg_A, reg_D); break;
-        case 0x83:
-            add(reg_A, reg_E); break;
-        case 0x84:
-            add(reg_A, reg_H); break;
-        case 0x85:
-            add(reg_A, reg_L); break;
-        case 0x86:
-            add(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0x87:
-            add(reg_A, reg_A); break;
-        case 0xC6:
-            add(reg_A, GetOperand8()); break;
-        // ADD reg16, u16
-        case 0x09:
-            add(reg_HL, reg_BC.word); break;
-        case 0x19:
-            add(reg_HL, reg_DE.word); break;
-        case 0x29:
-            add(reg_HL, reg_HL.word); break;
-        case 0x39:
-            add(reg_HL, reg_SP.word); break;
-        // ADD reg16, s8
-        case 0xE8:
-            add(reg_SP, static_cast<s8>(GetOperand8())); break;
-
-        // ADC reg8, u8
-        case 0x88:
-            adc(reg_A, reg_B); break;
-        case 0x89:
-            adc(reg_A, reg_C); break;
-        case 0x8A:
-            adc(reg_A, reg_D); break;
-        case 0x8B:
-            adc(reg_A, reg_E); break;
-        case 0x8C:
-            adc(reg_A, reg_H); break;
-        case 0x8D:
-            adc(reg_A, reg_L); break;
-        case 0x8E:
-            adc(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0x8F:
-            adc(reg_A, reg_A); break;
-        case 0xCE:
-            adc(reg_A, GetOperand8()); break;
-
-        // SUB reg8, u8
-        case 0x90:
-            sub(reg_A, reg_B); break;
-        case 0x91:
-            sub(reg_A, reg_C); break;
-        case 0x92:
-            sub(reg_A, reg_D); break;
-        case 0x93:
-            sub(reg_A, reg_E); break;
-        case 0x94:
-            sub(reg_A, reg_H); break;
-        case 0x95:
-            sub(reg_A, reg_L); break;
-        case 0x96:
-            sub(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0x97:
-            sub(reg_A, reg_A); break;
-        case 0xD6:
-            sub(reg_A, GetOperand8()); break;
-
-        // SBC reg8, u8
-        case 0x98:
-            sbc(reg_A, reg_B); break;
-        case 0x99:
-            sbc(reg_A, reg_C); break;
-        case 0x9A:
-            sbc(reg_A, reg_D); break;
-        case 0x9B:
-            sbc(reg_A, reg_E); break;
-        case 0x9C:
-            sbc(reg_A, reg_H); break;
-        case 0x9D:
-            sbc(reg_A, reg_L); break;
-        case 0x9E:
-            sbc(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0x9F:
-            sbc(reg_A, reg_A); break;
-        case 0xDE:
-            sbc(reg_A, GetOperand8()); break;
-
-        // AND reg8, u8
-        case 0xA0:
-            and8(reg_A, reg_B); break;
-        case 0xA1:
-            and8(reg_A, reg_C); break;
-        case 0xA2:
-            and8(reg_A, reg_D); break;
-        case 0xA3:
-            and8(reg_A, reg_E); break;
-        case 0xA4:
-            and8(reg_A, reg_H); break;
-        case 0xA5:
-            and8(reg_A, reg_L); break;
-        case 0xA6:
-            and8(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0xA7:
-            and8(reg_A, reg_A); break;
-        case 0xE6:
-            and8(reg_A, GetOperand8()); break;
-
-        // XOR reg8, u8
-        case 0xA8:
-            xor8(reg_A, reg_B); break;
-        case 0xA9:
-            xor8(reg_A, reg_C); break;
-        case 0xAA:
-            xor8(reg_A, reg_D); break;
-        case 0xAB:
-            xor8(reg_A, reg_E); break;
-        case 0xAC:
-            xor8(reg_A, reg_H); break;
-        case 0xAD:
-            xor8(reg_A, reg_L); break;
-        case 0xAE:
-            xor8(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0xAF:
-            xor8(reg_A, reg_A); break;
-        case 0xEE:
-            xor8(reg_A, GetOperand8()); break;
-        
-        // CPL
-        case 0x2F:
-            cpl(reg_A); break;
-        // CCF
-        case 0x3F:
-            ccf(); break;
-        // SCF
-        case 0x37:
-            scf(); break;
-
-        // OR reg8, u8
-        case 0xB0:
-            or8(reg_A, reg_B); break;
-        case 0xB1:
-            or8(reg_A, reg_C); break;
-        case 0xB2:
-            or8(reg_A, reg_D); break;
-        case 0xB3:
-            or8(reg_A, reg_E); break;
-        case 0xB4:
-            or8(reg_A, reg_H); break;
-        case 0xB5:
-            or8(reg_A, reg_L); break;
-        case 0xB6:
-            or8(reg_A, memory_bus->Read8(reg_HL.word)); break;
-        case 0xB7:
-            or8(reg_A, reg_A); break;
-        case 0xF6:
-            or8(reg_A, GetOperand8()); break;
-
-        // RLC reg8
-        case 0x07:
-            rlc(reg_A, false); break;
-        // RL reg8
-        case 0x17:
-            rl(reg_A, false); break;
-        // RRC reg8
-        case 0x0F:
-            rrc(reg_A, false); break;
-        // RR reg8
-        case 0x1F:
-            rr(reg_A, false); break;
-
-        // DAA
-        case 0x27:
-            daa(); break;
-
-        // CP u8
-        case 0xB8:
-            cp(reg_B); break;
-        case 0xB9:
-            cp(reg_C); break;
-        case 0xBA:
-            cp(reg_D); break;
-        case 0xBB:
-            cp(reg_E); break;
-        case 0xBC:
-            cp(reg_H); break;
-        case 0xBD:
-            cp(reg_L); break;
-        case 0xBE:
-            cp(memory_bus->Read8(reg_HL.word)); break;
-        case 0xBF:
-            cp(reg_A); break;
-        case 0xFE:
-            cp(GetOperand8()); break;
-
-        // JR s8
-        case 0x18:
-            jr(static_cast<s8>(GetOperand8()));
-            break;
-        case 0x20:
-            if(!Zero()) {
-                branch_taken = true;
-                jr(static_cast<s8>(GetOperand8()));
-                break;
-            }
-            reg_PC.word++;
-            break;
-        case 0x28:
-            if(Zero()) {
-                branch_taken = true;
-                jr(static_cast<s8>(GetOperand8()));
-                break;
-            }
-            reg_PC.word++;
-            break;
-        case 0x30:
-            if(!Carry()) {
-                branch_taken = true;
-                jr(static_cast<s8>(GetOperand8()));
-                break;
-            }
-            reg_PC.word++;
-            break;
-        case 0x38:
-            if(Carry()) {
-                branch_taken = true;
-                jr(static_cast<s8>(GetOperand8()));
-                break;
-            }
-            reg_PC.word++;
-            break;
+// JP u16
+template<> int Processor::Op<0xC3>() { return Cycles(0xC3) + jp(Operand16()); }
+template<> int Processor::Op<0xC2>()
+{
+    if(!Zero()) {
+        return BranchCycles(0xC2) + jp(Operand16());
+    }
+    return Cycles(0xC2);
+}
+template<> int Processor::Op<0xCA>()
+{
+    if(Zero()) {
+        return BranchCycles(0xCA) + jp(Operand16());
+    }
+    return Cycles(0xCA);
+}
+template<> int Processor::Op<0xD2>()
+{
+    if(!Carry()) {
+        return BranchCycles(0xD2) + jp(Operand16());
+    }
+    return Cycles(0xD2);
+}
+template<> int Processor::Op<0xDA>()
+{
+    if(Carry()) {
+        return BranchCycles(0xDA) + jp(Operand16());
+    }
+    return Cycles(0xDA);
+}
+// A computed jump; left out of idle loop detection
+template<> int Processor::Op<0xE9>() { reg_PC.word = reg_HL.word; return Cycles(0xE9); }
 
-        // JP u16
-        case 0xC3:
-            jp(GetOperand16());
-            break;
-        case 0xC2:
-            if(!Zero()) {
-                branch_taken = true;
-                jp(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xCA:
-            if(Zero()) {
-                branch_taken = true;
-                jp(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xD2:
-            if(!Carry()) {
-                branch_taken = true;
-                jp(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xDA:
-            if(Carry()) {
-                branch_taken = true;
-                jp(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xE9:
-            jp(reg_HL.word);
-            break;
+// CALL u16
+template<> int Processor::Op<0xCD>() { call(Operand16()); return Cycles(0xCD); }
+template<> int Processor::Op<0xC4>()
+{
+    if(!Zero()) {
+        call(Operand16());
+        return BranchCycles(0xC4);
+    }
+    return Cycles(0xC4);
+}
+template<> int Processor::Op<0xCC>()
+{
+    if(Zero()) {
+        call(Operand16());
+        return BranchCycles(0xCC);
+    }
+    return Cycles(0xCC);
+}
+template<> int Processor::Op<0xD4>()
+{
+    if(!Carry()) {
+        call(Operand16());
+        return BranchCycles(0xD4);
+    }
+    return Cycles(0xD4);
+}
+template<> int Processor::Op<0xDC>()
+{
+    if(Carry()) {
+        call(Operand16());
+        return BranchCycles(0xDC);
+    }
+    return Cycles(0xDC);
+}
 
-        // CALL u16
-        case 0xCD:
-            call(GetOperand16());
-            break;
-        case 0xC4:
-            if(!Zero()) {
-                branch_taken = true;
-                call(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xCC:
-            if(Zero()) {
-                branch_taken = true;
-                call(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xD4:
-            if(!Carry()) {
-                branch_taken = true;
-                call(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
-        case 0xDC:
-            if(Carry()) {
-                branch_taken = true;
-                call(GetOperand16());
-                break;
-            }
-            reg_PC.word += 2;
-            break;
+// RST XXh
+template<> int Processor::Op<0xC7>() { call(0x0000); return Cycles(0xC7); }
+template<> int Processor::Op<0xCF>() { call(0x0008); return Cycles(0xCF); }
+template<> int Processor::Op<0xD7>() { call(0x0010); return Cycles(0xD7); }
+template<> int Processor::Op<0xDF>() { call(0x0018); return Cycles(0xDF); }
+template<> int Processor::Op<0xE7>() { call(0x0020); return Cycles(0xE7); }
+template<> int Processor::Op<0xEF>() { call(0x0028); return Cycles(0xEF); }
+template<> int Processor::Op<0xF7>() { call(0x0030); return Cycles(0xF7); }
+template<> int Processor::Op<0xFF>() { call(0x0038); return Cycles(0xFF); }
 
-        // RST XXh
-        case 0xC7:
-            call(0x0000); break;
-        case 0xCF:
-            call(0x0008); break;
-        case 0xD7:
-            call(0x0010); break;
-        case 0xDF:
-            call(0x0018); break;
-        case 0xE7:
-            call(0x0020); break;
-        case 0xEF:
-            call(0x0028); break;
-        case 0xF7:
-            call(0x0030); break;
-        case 0xFF:
-            call(0x0038); break;
-
-        // RET
-        case 0xC9:
-            ret();
-            break;
-        case 0xC0:
-            if(!Zero()) {
-                branch_taken = true;
-                ret();
-                break;
-            }
-            break;
-        case 0xC8:
-            if(Zero()) {
-                branch_taken = true;
-                ret();
-                break;
-            }
-            break;
-        case 0xD0:
-            if(!Carry()) {
-                branch_taken = true;
-                ret();
-                break;
-            }
-            break;
-        case 0xD8:
-            if(Carry()) {
-                branch_taken = true;
-                ret();
-                break;
-            }
-            break;
-        case 0xD9:
-            IME = true;
-            ret();
-            break;
+// RET
+template<> int Processor::Op<0xC9>() { ret(); return Cycles(0xC9); }
+template<> int Processor::Op<0xC0>()
+{
+    if(!Zero()) {
+        ret();
+        return BranchCycles(0xC0);
+    }
+    return Cycles(0xC0);
+}
+template<> int Processor::Op<0xC8>()
+{
+    if(Zero()) {
+        ret();
+        return BranchCycles(0xC8);
+    }
+    return Cycles(0xC8);
+}
+template<> int Processor::Op<0xD0>()
+{
+    if(!Carry()) {
+        ret();
+        return BranchCycles(0xD0);
+    }
+    return Cycles(0xD0);
+}
+template<> int Processor::Op<0xD8>()
+{
+    if(Carry()) {
+        ret();
+        return BranchCycles(0xD8);
+    }
+    return Cycles(0xD8);
+}
+template<> int Processor::Op<0xD9>()
+{
+    IME = true;
+    ret();
+    return Cycles(0xD9);
+}
 
-        // PUSH reg16
-        case 0xC5:
-            push(reg_BC.word); break;
-        case 0xD5:
-            push(reg_DE.word); break;
-        case 0xE5:
-            push(reg_HL.word); break;
-        case 0xF5:
-            push(reg_AF.word); break;
-
-        // POP reg16
-        case 0xC1:
-            pop(reg_BC); break;
-        case 0xD1:
-            pop(reg_DE); break;
-        case 0xE1:
-            pop(reg_HL); break;
-        case 0xF1: {
-            pop(reg_AF);
-            // Lower 4 bits of F must be 0
-            reg_F &= 0xF0;
-            break;
-        }
+// PUSH reg16
+template<> int Processor::Op<0xC5>() { push(reg_BC.word); return Cycles(0xC5); }
+template<> int Processor::Op<0xD5>() { push(reg_DE.word); return Cycles(0xD5); }
+template<> int Processor::Op<0xE5>() { push(reg_HL.word); return Cycles(0xE5); }
+template<> int Processor::Op<0xF5>() { SyncFlags(); push(reg_AF.word); return Cycles(0xF5); }
 
-        default:
-            Debug::Logger::LogDisassembly(memory_bus, reg_PC.word - 1, 1);
-            LOG_ERROR("Unknown opcode!");
-            gameboy->Stop();
+// POP reg16
+template<> int Processor::Op<0xC1>() { pop(reg_BC); return Cycles(0xC1); }
+template<> int Processor::Op<0xD1>() { pop(reg_DE); return Cycles(0xD1); }
+template<> int Processor::Op<0xE1>() { pop(reg_HL); return Cycles(0xE1); }
+template<> int Processor::Op<0xF1>()
+{
+    DiscardFlags();
+    pop(reg_AF);
+    // Lower 4 bits of F must be 0
+    reg_F &= 0xF0;
+    return Cycles(0xF1);
+}
+template<> int Processor::Op<0xCB>();
+
+// Dispatch trampolines; the immediate operand is fetched here
+// so handlers can read it with Operand8()/Operand16()
+template<u8 opcode>
+int Processor::Execute(Processor& cpu)
+{
+    // length is a constant, so only one of these survives
+    switch(OPCODE_LOOKUP[opcode].length)
+    {
+    case 2:
+        cpu.operand = cpu.memory_bus->Read8(cpu.reg_PC.word++);
+        break;
+    case 3:
+        cpu.operand = cpu.memory_bus->Read16(cpu.reg_PC.word);
+        cpu.reg_PC.word += 2;
+        break;
     }
+    return cpu.Op<opcode>();
+}
+
+template<u8 opcode>
+int Processor::ExecuteDecoded(Processor& cpu)
+{
+    return cpu.Op<opcode>();
+}
 
-    return (!branch_taken)?
-        opcode_lookup_table[opcode].cycles : opcode_lookup_table[opcode].cycles_branch;
+template<u8 opcode>
+int Processor::ExecuteCB(Processor& cpu)
+{
+    return cpu.OpCB<opcode>();
 }
 
-u8 Processor::ExecuteCBOpcode()
+// Builds the 0x00-0xFF index list the handler tables are expanded from
+template<int... opcodes> struct OpcodeList {};
+template<int n, int... opcodes>
+struct MakeOpcodeList : MakeOpcodeList<n - 1, n - 1, opcodes...> {};
+template<int... opcodes>
+struct MakeOpcodeList<0, opcodes...> { typedef OpcodeList<opcodes...> type; };
+
+template<typename List> struct OpcodeHandlerTable;
+template<int... opcodes>
+struct OpcodeHandlerTable<OpcodeList<opcodes...>>
+{
+    static const Processor::OpcodeHandler main[256];
+    static const Processor::OpcodeHandler decoded[256];
+    static const Processor::OpcodeHandler cb[256];
+};
+template<int... opcodes>
+const Processor::OpcodeHandler OpcodeHandlerTable<OpcodeList<opcodes...>>::main[256] =
+    { &Processor::Execute<opcodes>... };
+template<int... opcodes>
+const Processor::OpcodeHandler OpcodeHandlerTable<OpcodeList<opcodes...>>::decoded[256] =
+    { &Processor::ExecuteDecoded<opcodes>... };
+template<int... opcodes>
+const Processor::OpcodeHandler OpcodeHandlerTable<OpcodeList<opcodes...>>::cb[256] =
+    { &Processor::ExecuteCB<opcodes>... };
+
+typedef OpcodeHandlerTable<MakeOpcodeList<256>::type> HandlerTable;
+
+// CB
+template<> int Processor::Op<0xCB>()
 {
     u8 opcode = memory_bus->Read8(reg_PC.word++);
+    return HandlerTable::cb[opcode](*this);
+}
 
-    switch(opcode)
+// Tracing policies for the interpreter
+struct Processor::NoTrace
+{
+    static void Record(Processor&, u16, u8) {}
+};
+struct Processor::BinaryTrace
+{
+    static void Record(Processor& cpu, u16 pc, u8 opcode)
     {
-        // RLC reg8
-        case 0x00:    
-            rlc(reg_B, true); break;
-        case 0x01:    
-            rlc(reg_C, true); break;
-        case 0x02:    
-            rlc(reg_D, true); break;
-        case 0x03:    
-            rlc(reg_E, true); break;
-        case 0x04:    
-            rlc(reg_H, true); break;
-        case 0x05:    
-            rlc(reg_L, true); break;
-        case 0x06:    
-            rlcAt(reg_HL.word, true); break;
-        case 0x07:    
-            rlc(reg_A, true); break;
-
-        // RL reg8
-        case 0x10:
-            rl(reg_B, true); break;
-        case 0x11:
-            rl(reg_C, true); break;
-        case 0x12:
-            rl(reg_D, true); break;
-        case 0x13:
-            rl(reg_E, true); break;
-        case 0x14:
-            rl(reg_H, true); break;
-        case 0x15:
-            rl(reg_L, true); break;
-        case 0x16:
-            rlAt(reg_HL.word, true); break;
-        case 0x17:
-            rl(reg_A, true); break;
-
-        // RRC reg8
-        case 0x08:
-            rrc(reg_B, true); break;
-        case 0x09:
-            rrc(reg_C, true); break;
-        case 0x0A:
-            rrc(reg_D, true); break;
-        case 0x0B:
-            rrc(reg_E, true); break;
-        case 0x0C:
-            rrc(reg_H, true); break;
-        case 0x0D:
-            rrc(reg_L, true); break;
-        case 0x0E:
-            rrcAt(reg_HL.word, true); break;
-        case 0x0F:
-            rrc(reg_A, true); break;
-
-        // RR reg8
-        case 0x18:
-            rr(reg_B, true); break;
-        case 0x19:
-            rr(reg_C, true); break;
-        case 0x1A:
-            rr(reg_D, true); break;
-        case 0x1B:
-            rr(reg_E, true); break;
-        case 0x1C:
-            rr(reg_H, true); break;
-        case 0x1D:
-            rr(reg_L, true); break;
-        case 0x1E:
-            rrAt(reg_HL.word, true); break;
-        case 0x1F:
-            rr(reg_A, true); break;
-
-        // SLA reg8
-        case 0x20:
-            sla(reg_B); break;
-        case 0x21:
-            sla(reg_C); break;
-        case 0x22:
-            sla(reg_D); break;
-        case 0x23:
-            sla(reg_E); break;
-        case 0x24:
-            sla(reg_H); break;
-        case 0x25:
-            sla(reg_L); break;
-        case 0x26:
-            slaAt(reg_HL.word); break;
-        case 0x27:
-            sla(reg_A); break;
-
-        // SRA reg8
-        case 0x28:
-            sra(reg_B); break;
-        case 0x29:
-            sra(reg_C); break;
-        case 0x2A:
-            sra(reg_D); break;
-        case 0x2B:
-            sra(reg_E); break;
-        case 0x2C:
-            sra(reg_H); break;
-        case 0x2D:
-            sra(reg_L); break;
-        case 0x2E:
-            sraAt(reg_HL.word); break;
-        case 0x2F:
-            sra(reg_A); break;
-
-        // SWAP reg8
-        case 0x30:
-            swap(reg_B); break;
-        case 0x31:
-            swap(reg_C); break;
-        case 0x32:
-            swap(reg_D); break;
-        case 0x33:
-            swap(reg_E); break;
-        case 0x34:
-            swap(reg_H); break;
-        case 0x35:
-            swap(reg_L); break;
-        case 0x36:
-            swapAt(reg_HL.word); break;
-        case 0x37:
-            swap(reg_A); break;
-
-        // SRL reg8
-        case 0x38:
-            srl(reg_B); break;
-        case 0x39:
-            srl(reg_C); break;
-        case 0x3A:
-            srl(reg_D); break;
-        case 0x3B:
-            srl(reg_E); break;
-        case 0x3C:
-            srl(reg_H); break;
-        case 0x3D:
-            srl(reg_L); break;
-        case 0x3E:
-            srlAt(reg_HL.word); break;
-        case 0x3F:
-            srl(reg_A); break;
-
-        // BIT x, u8
-        case 0x40:
-            bit(reg_B, 0); break;
-        case 0x41:
-            bit(reg_C, 0); break;
-        case 0x42:
-            bit(reg_D, 0); break;
-        case 0x43:
-            bit(reg_E, 0); break;
-        case 0x44:
-            bit(reg_H, 0); break;
-        case 0x45:
-            bit(reg_L, 0); break;
-        case 0x46:
-            bit(memory_bus->Read8(reg_HL.word), 0); break;
-        case 0x47:
-            bit(reg_A, 0); break;
-        case 0x48:
-            bit(reg_B, 1); break;
-        case 0x49:
-            bit(reg_C, 1); break;
-        case 0x4A:
-            bit(reg_D, 1); break;
-        case 0x4B:
-            bit(reg_E, 1); break;
-        case 0x4C:
-            bit(reg_H, 1); break;
-        case 0x4D:
-            bit(reg_L, 1); break;
-        case 0x4E:
-            bit(memory_bus->Read8(reg_HL.word), 1); break;
-        case 0x4F:
-            bit(reg_A, 1); break;
-        case 0x50:
-            bit(reg_B, 2); break;
-        case 0x51:
-            bit(reg_C, 2); break;
-        case 0x52:
-            bit(reg_D, 2); break;
-        case 0x53:
-            bit(reg_E, 2); break;
-        case 0x54:
-            bit(reg_H, 2); break;
-        case 0x55:
-            bit(reg_L, 2); break;
-        case 0x56:
-            bit(memory_bus->Read8(reg_HL.word), 2); break;
-        case 0x57:
-            bit(reg_A, 2); break;
-        case 0x58:
-            bit(reg_B, 3); break;
-        case 0x59:
-            bit(reg_C, 3); break;
-        case 0x5A:
-            bit(reg_D, 3); break;
-        case 0x5B:
-            bit(reg_E, 3); break;
-        case 0x5C:
-            bit(reg_H, 3); break;
-        case 0x5D:
-            bit(reg_L, 3); break;
-        case 0x5E:
-            bit(memory_bus->Read8(reg_HL.word), 3); break;
-        case 0x5F:
-            bit(reg_A, 3); break;
-        case 0x60:
-            bit(reg_B, 4); break;
-        case 0x61:
-            bit(reg_C, 4); break;
-        case 0x62:
-            bit(reg_D, 4); break;
-        case 0x63:
-            bit(reg_E, 4); break;
-        case 0x64:
-            bit(reg_H, 4); break;
-        case 0x65:
-            bit(reg_L, 4); break;
-        case 0x66:
-            bit(memory_bus->Read8(reg_HL.word), 4); break;
-        case 0x67:
-            bit(reg_A, 4); break;
-        case 0x68:
-            bit(reg_B, 5); break;
-        case 0x69:
-            bit(reg_C, 5); break;
-        case 0x6A:
-            bit(reg_D, 5); break;
-        case 0x6B:
-            bit(reg_E, 5); break;
-        case 0x6C:
-            bit(reg_H, 5); break;
-        case 0x6D:
-            bit(reg_L, 5); break;
-        case 0x6E:
-            bit(memory_bus->Read8(reg_HL.word), 5); break;
-        case 0x6F:
-            bit(reg_A, 5); break;
-        case 0x70:
-            bit(reg_B, 6); break;
-        case 0x71:
-            bit(reg_C, 6); break;
-        case 0x72:
-            bit(reg_D, 6); break;
-        case 0x73:
-            bit(reg_E, 6); break;
-        case 0x74:
-            bit(reg_H, 6); break;
-        case 0x75:
-            bit(reg_L, 6); break;
-        case 0x76:
-            bit(memory_bus->Read8(reg_HL.word), 6); break;
-        case 0x77:
-            bit(reg_A, 6); break;
-        case 0x78:
-            bit(reg_B, 7); break;
-        case 0x79:
-            bit(reg_C, 7); break;
-        case 0x7A:
-            bit(reg_D, 7); break;
-        case 0x7B:
-            bit(reg_E, 7); break;
-        case 0x7C:
-            bit(reg_H, 7); break;
-        case 0x7D:
-            bit(reg_L, 7); break;
-        case 0x7E:
-            bit(memory_bus->Read8(reg_HL.word), 7); break;
-        case 0x7F:
-            bit(reg_A, 7); break;
-
-        // RES x, reg8
-        case 0x80:
-            res(reg_B, 0); break;
-        case 0x81:
-            res(reg_C, 0); break;
-        case 0x82:
-            res(reg_D, 0); break;
-        case 0x83:
-            res(reg_E, 0); break;
-        case 0x84:
-            res(reg_H, 0); break;
-        case 0x85:
-            res(reg_L, 0); break;
-        case 0x86:
-            resAt(reg_HL.word, 0); break;
-        case 0x87:
-            res(reg_A, 0); break;
-        case 0x88:
-            res(reg_B, 1); break;
-        case 0x89:
-            res(reg_C, 1); break;
-        case 0x8A:
-            res(reg_D, 1); break;
-        case 0x8B:
-            res(reg_E, 1); break;
-        case 0x8C:
-            res(reg_H, 1); break;
-        case 0x8D:
-            res(reg_L, 1); break;
-        case 0x8E:
-            resAt(reg_HL.word, 1); break;
-        case 0x8F:
-            res(reg_A, 1); break;
-        case 0x90:
-            res(reg_B, 2); break;
-        case 0x91:
-            res(reg_C, 2); break;
-        case 0x92:
-            res(reg_D, 2); break;
-        case 0x93:
-            res(reg_E, 2); break;
-        case 0x94:
-            res(reg_H, 2); break;
-        case 0x95:
-            res(reg_L, 2); break;
-        case 0x96:
-            resAt(reg_HL.word, 2); break;
-        case 0x97:
-            res(reg_A, 2); break;
-        case 0x98:
-            res(reg_B, 3); break;
-        case 0x99:
-            res(reg_C, 3); break;
-        case 0x9A:
-            res(reg_D, 3); break;
-        case 0x9B:
-            res(reg_E, 3); break;
-        case 0x9C:
-            res(reg_H, 3); break;
-        case 0x9D:
-            res(reg_L, 3); break;
-        case 0x9E:
-            resAt(reg_HL.word, 3); break;
-        case 0x9F:
-            res(reg_A, 3); break;
-        case 0xA0:
-            res(reg_B, 4); break;
-        case 0xA1:
-            res(reg_C, 4); break;
-        case 0xA2:
-            res(reg_D, 4); break;
-        case 0xA3:
-            res(reg_E, 4); break;
-        case 0xA4:
-            res(reg_H, 4); break;
-        case 0xA5:
-            res(reg_L, 4); break;
-        case 0xA6:
-            resAt(reg_HL.word, 4); break;
-        case 0xA7:
-            res(reg_A, 4); break;
-        case 0xA8:
-            res(reg_B, 5); break;
-        case 0xA9:
-            res(reg_C, 5); break;
-        case 0xAA:
-            res(reg_D, 5); break;
-        case 0xAB:
-            res(reg_E, 5); break;
-        case 0xAC:
-            res(reg_H, 5); break;
-        case 0xAD:
-            res(reg_L, 5); break;
-        case 0xAE:
-            resAt(reg_HL.word, 5); break;
-        case 0xAF:
-            res(reg_A, 5); break;
-        case 0xB0:
-            res(reg_B, 6); break;
-        case 0xB1:
-            res(reg_C, 6); break;
-        case 0xB2:
-            res(reg_D, 6); break;
-        case 0xB3:
-            res(reg_E, 6); break;
-        case 0xB4:
-            res(reg_H, 6); break;
-        case 0xB5:
-            res(reg_L, 6); break;
-        case 0xB6:
-            resAt(reg_HL.word, 6); break;
-        case 0xB7:
-            res(reg_A, 6); break;
-        case 0xB8:
-            res(reg_B, 7); break;
-        case 0xB9:
-            res(reg_C, 7); break;
-        case 0xBA:
-            res(reg_D, 7); break;
-        case 0xBB:
-            res(reg_E, 7); break;
-        case 0xBC:
-            res(reg_H, 7); break;
-        case 0xBD:
-            res(reg_L, 7); break;
-        case 0xBE:
-            resAt(reg_HL.word, 7); break;
-        case 0xBF:
-            res(reg_A, 7); break;
-
-        // SET x, reg8
-        case 0xC0:
-            set(reg_B, 0); break;
-        case 0xC1:
-            set(reg_C, 0); break;
-        case 0xC2:
-            set(reg_D, 0); break;
-        case 0xC3:
-            set(reg_E, 0); break;
-        case 0xC4:
-            set(reg_H, 0); break;
-        case 0xC5:
-            set(reg_L, 0); break;
-        case 0xC6:
-            setAt(reg_HL.word, 0); break;
-        case 0xC7:
-            set(reg_A, 0); break;
-        case 0xC8:
-            set(reg_B, 1); break;
-        case 0xC9:
-            set(reg_C, 1); break;
-        case 0xCA:
-            set(reg_D, 1); break;
-        case 0xCB:
-            set(reg_E, 1); break;
-        case 0xCC:
-            set(reg_H, 1); break;
-        case 0xCD:
-            set(reg_L, 1); break;
-        case 0xCE:
-            setAt(reg_HL.word, 1); break;
-        case 0xCF:
-            set(reg_A, 1); break;
-        case 0xD0:
-            set(reg_B, 2); break;
-        case 0xD1:
-            set(reg_C, 2); break;
-        case 0xD2:
-            set(reg_D, 2); break;
-        case 0xD3:
-            set(reg_E, 2); break;
-        case 0xD4:
-            set(reg_H, 2); break;
-        case 0xD5:
-            set(reg_L, 2); break;
-        case 0xD6:
-            setAt(reg_HL.word, 2); break;
-        case 0xD7:
-            set(reg_A, 2); break;
-        case 0xD8:
-            set(reg_B, 3); break;
-        case 0xD9:
-            set(reg_C, 3); break;
-        case 0xDA:
-            set(reg_D, 3); break;
-        case 0xDB:
-            set(reg_E, 3); break;
-        case 0xDC:
-            set(reg_H, 3); break;
-        case 0xDD:
-            set(reg_L, 3); break;
-        case 0xDE:
-            setAt(reg_HL.word, 3); break;
-        case 0xDF:
-            set(reg_A, 3); break;
-        case 0xE0:
-            set(reg_B, 4); break;
-        case 0xE1:
-            set(reg_C, 4); break;
-        case 0xE2:
-            set(reg_D, 4); break;
-        case 0xE3:
-            set(reg_E, 4); break;
-        case 0xE4:
-            set(reg_H, 4); break;
-        case 0xE5:
-            set(reg_L, 4); break;
-        case 0xE6:
-            setAt(reg_HL.word, 4); break;
-        case 0xE7:
-            set(reg_A, 4); break;
-        case 0xE8:
-            set(reg_B, 5); break;
-        case 0xE9:
-            set(reg_C, 5); break;
-        case 0xEA:
-            set(reg_D, 5); break;
-        case 0xEB:
-            set(reg_E, 5); break;
-        case 0xEC:
-            set(reg_H, 5); break;
-        case 0xED:
-            set(reg_L, 5); break;
-        case 0xEE:
-            setAt(reg_HL.word, 5); break;
-        case 0xEF:
-            set(reg_A, 5); break;
-        case 0xF0:
-            set(reg_B, 6); break;
-        case 0xF1:
-            set(reg_C, 6); break;
-        case 0xF2:
-            set(reg_D, 6); break;
-        case 0xF3:
-            set(reg_E, 6); break;
-        case 0xF4:
-            set(reg_H, 6); break;
-        case 0xF5:
-            set(reg_L, 6); break;
-        case 0xF6:
-            setAt(reg_HL.word, 6); break;
-        case 0xF7:
-            set(reg_A, 6); break;
-        case 0xF8:
-            set(reg_B, 7); break;
-        case 0xF9:
-            set(reg_C, 7); break;
-        case 0xFA:
-            set(reg_D, 7); break;
-        case 0xFB:
-            set(reg_E, 7); break;
-        case 0xFC:
-            set(reg_H, 7); break;
-        case 0xFD:
-            set(reg_L, 7); break;
-        case 0xFE:
-            setAt(reg_HL.word, 7); break;
-        case 0xFF:
-            set(reg_A, 7); break;
-
-        default:
-            Debug::Logger::LogDisassembly(memory_bus, reg_PC.word - 2, 1);
-            LOG_ERROR("Unknown extended opcode!");
-            gameboy->Stop();
+        Debug::TraceRecord record;
+        record.cycle = cpu.scheduler.GetNow();
+        record.pc = pc;
+        record.sp = cpu.reg_SP.word;
+        record.af = (cpu.reg_A << 8) | cpu.GetF();
+        record.bc = cpu.reg_BC.word;
+        record.de = cpu.reg_DE.word;
+        record.hl = cpu.reg_HL.word;
+        record.opcode = opcode;
+        record.ime = cpu.IME;
+        record.reserved[0] = record.reserved[1] = 0;
+        cpu.tracer->Record(record);
     }
+};
 
-    return opcode;
+// Decodes and executes instruction
+template<typename Trace>
+int Processor::Interpret()
+{
+    u8 opcode = memory_bus->Read8(reg_PC.word++);
+    Trace::Record(*this, reg_PC.word - 1, opcode);
+
+    return HandlerTable::main[opcode](*this);
+}
+
+void Processor::SetTracer(Debug::Tracer* tracer)
+{
+    this->tracer = tracer;
+    if(tracer != nullptr)
+        interpret = &Processor::Interpret<BinaryTrace>;
+    else
+        interpret = &Processor::Interpret<NoTrace>;
+    use_block_cache = gameboy->GetOptions().block_cache && tracer == nullptr;
+    use_jit = use_block_cache && recompiler.IsAvailable();
+}
+
+// The HALT bug: the opcode after HALT is fetched
+// without incrementing PC, so its byte is read twice
+int Processor::ExecuteHaltBug()
+{
+    halt_bug = false;
+    u8 opcode = memory_bus->Read8(reg_PC.word);
+
+    return HandlerTable::main[opcode](*this);
+}
+
+const Processor::OpcodeHandler* Processor::GetDecodedHandlers()
+{
+    return HandlerTable::decoded;
+}
+
+const Processor::OpcodeHandler* Processor::GetCBHandlers()
+{
+    return HandlerTable::cb;
 }
 
 }; // namespace Core
@@ -13,6 +13,10 @@
 // limitations under the License.
 
 #pragma once
+#include "BlockCache.h"
+#include "IdleLoop.h"
+#include "Recompiler.h"
+#include "../Scheduler.h"
 
 #include "../../common/Types.h"
 
@@ -31,67 +35,219 @@ namespace Debug {
     namespace Logger {
         void LogRegisters(const Core::Processor& processor);
     }; // namespace Logger
+    class Lockstep;
+    class Tracer;
 }; // namespace Debug
 
 namespace Core {
 class GameBoy;
 
-class Processor
+// Everything the CPU needs to resume execution, kept as
+// plain data so it can be copied around with memcpy
+struct ProcessorState
 {
-    friend class Memory::MemoryBus;
-    friend void Debug::Logger::LogRegisters(const Core::Processor& processor);
-
+    // Register file, laid out so a little-endian pair
+    // like BC reads as r16[0] and C, B as r8[0], r8[1]
+    union
+    {
+        Reg8 r8[8];
+        Reg16 r16[4];
+        struct
+        {
+            Reg8 reg_C, reg_B;
+            Reg8 reg_E, reg_D;
+            Reg8 reg_L, reg_H;
+            Reg8 reg_F, reg_A;
+        };
+        struct
+        {
+            Reg16 reg_BC;
+            Reg16 reg_DE;
+            Reg16 reg_HL;
+            Reg16 reg_AF;
+        };
+    };
     // 16-bit program counter and stack pointer
     Reg16 reg_PC;
     Reg16 reg_SP;
-    // 8-bit register pairs are linked
-    // together to make 16-bit registers
-    Reg16 reg_AF;
-    Reg16 reg_BC;
-    Reg16 reg_DE;
-    Reg16 reg_HL;
-    // 8-bit registers point to halves of 16-bit pairs
-    Reg8& reg_B = reg_BC.high;
-    Reg8& reg_C = reg_BC.low;
-    Reg8& reg_D = reg_DE.high;
-    Reg8& reg_E = reg_DE.low;
-    Reg8& reg_H = reg_HL.high;
-    Reg8& reg_L = reg_HL.low;
-    Reg8& reg_A = reg_AF.high;
-    Reg8& reg_F = reg_AF.low;
-
-    inline void SetZero(bool value) {       (value)? (reg_F |= 0x80) : (reg_F &= ~0x80); }
-    inline void SetSubtract(bool value) {   (value)? (reg_F |= 0x40) : (reg_F &= ~0x40); }
-    inline void SetHalfCarry(bool value) {  (value)? (reg_F |= 0x20) : (reg_F &= ~0x20); }
-    inline void SetCarry(bool value) {      (value)? (reg_F |= 0x10) : (reg_F &= ~0x10); }
-    inline bool Zero() {                    return ((reg_F & 0x80) != 0x00); }
-    inline bool Subtract() {                return ((reg_F & 0x40) != 0x00); }
-    inline bool HalfCarry() {               return ((reg_F & 0x20) != 0x00); }
-    inline bool Carry() {                   return ((reg_F & 0x10) != 0x00); }
 
     // Interrupt registers
     bool IME;
     u8 IE;
     u8 IF;
+    // Waiting in HALT for an interrupt
+    bool halted;
+    // HALT ran into a pending interrupt with IME off
+    bool halt_bug;
+
+    // The 8-bit ALU only records its operands; the flags
+    // are worked out when something actually reads them
+    enum FlagOp : u8
+    {
+        FLAGS_NONE,
+        FLAGS_ADD,
+        FLAGS_SUB,
+        FLAGS_AND,
+        FLAGS_OR,
+        FLAGS_INC,
+        FLAGS_DEC
+    };
+    struct
+    {
+        FlagOp op;
+        // Flags in F the pending operation owns
+        u8 mask;
+        u8 a;
+        u8 b;
+        u8 carry;
+    } lazy_flags;
+
+    // Immediate operand of the instruction being executed
+    u16 operand;
+};
+
+// Maps an opcode's 3-bit register field (B C D E H L (HL) A)
+// to its slot in r8; (HL) has no slot and is handled separately
+static constexpr int R8Index(int field)
+    { return (field == 7)? 7 : (field ^ 1); }
+
+class Processor : private ProcessorState
+{
+    friend void Debug::Logger::LogRegisters(const Core::Processor& processor);
+    friend class Debug::Lockstep;
+    friend class Recompiler;
+
+    inline void SetZero(bool value) {       SyncFlags(); (value)? (reg_F |= 0x80) : (reg_F &= ~0x80); }
+    inline void SetSubtract(bool value) {   SyncFlags(); (value)? (reg_F |= 0x40) : (reg_F &= ~0x40); }
+    inline void SetHalfCarry(bool value) {  SyncFlags(); (value)? (reg_F |= 0x20) : (reg_F &= ~0x20); }
+    inline void SetCarry(bool value) {      SyncFlags(); (value)? (reg_F |= 0x10) : (reg_F &= ~0x10); }
+    inline bool Zero() {                    SyncFlags(); return ((reg_F & 0x80) != 0x00); }
+    inline bool Subtract() {                SyncFlags(); return ((reg_F & 0x40) != 0x00); }
+    inline bool HalfCarry() {               SyncFlags(); return ((reg_F & 0x20) != 0x00); }
+    inline bool Carry() {                   SyncFlags(); return ((reg_F & 0x10) != 0x00); }
+
+    inline void DeferFlags(FlagOp op, u8 mask, u8 a, u8 b, u8 carry = 0)
+    {
+        // Anything the new operation leaves alone must be settled first
+        if(lazy_flags.mask & ~mask)
+            SyncFlags();
+        lazy_flags.op = op;
+        lazy_flags.mask = mask;
+        lazy_flags.a = a;
+        lazy_flags.b = b;
+        lazy_flags.carry = carry;
+    }
+    inline void SyncFlags() {               if(lazy_flags.op != FLAGS_NONE) { reg_F = GetF(); lazy_flags.op = FLAGS_NONE; lazy_flags.mask = 0; } }
+    inline void DiscardFlags() {            lazy_flags.op = FLAGS_NONE; lazy_flags.mask = 0; }
+
     int TickInterrupts();
+    // Interpreter, built once per tracing policy
+    struct NoTrace;
+    struct BinaryTrace;
+    template<typename Trace> int Interpret();
+    int TickHalted();
+    int ExecuteHaltBug();
+    int RunCached(int budget);
+    int RunBlocks(const MicroOp* op, const MicroOp* end, int budget);
+    CompiledBlock Compiled(const MicroOp* op);
+    int SkipIdleLoop(u16 branch);
+
+    inline u8 Operand8() {                  return static_cast<u8>(operand); }
+    inline u16 Operand16() {                return operand; }
+
+    // Opcode handlers; one specialization per opcode,
+    // each returns the cycles it took
+    template<u8 opcode> int Op();
+    template<u8 opcode> int OpCB();
+    template<u8 opcode> static int Execute(Processor& cpu);
+    template<u8 opcode> static int ExecuteDecoded(Processor& cpu);
+    template<u8 opcode> static int ExecuteCB(Processor& cpu);
+    template<typename List> friend struct OpcodeHandlerTable;
+    // LD r,r' and ALU A,r take their registers straight
+    // from the opcode's bit fields; see R8Index()
+    template<int field> u8 GetR8();
+    template<int field> void SetR8(u8 value);
+    template<u8 opcode> int OpLoad();
+    template<u8 opcode> int OpALU();
+
+    // Decoded ROM code, and host code for the hot parts of it
+    BlockCache block_cache;
+    Recompiler recompiler;
+    // Polling loops that can be skipped like HALT
+    IdleLoopDetector idle_loops;
+
+    // Interpreter variant picked by SetTracer, so nothing
+    // is checked per instruction when tracing is off
+    int (Processor::*interpret)();
+    Debug::Tracer* tracer = nullptr;
+    bool use_block_cache;
+    bool use_jit;
+
+    // Source address of the OAM DMA in progress
+    u16 dma_source = 0;
+
+    // Most cycles a single HALT step may skip
+    static const int MAX_HALT_SKIP = 70224;
+    // Cycles skipped over while halted
+    u64 halted_cycles = 0;
 
     GameBoy* gameboy;
+    Scheduler& scheduler;
     std::shared_ptr<Memory::MemoryBus> memory_bus;
 
 public:
     Processor(GameBoy* gameboy,
               std::shared_ptr<Memory::MemoryBus>& memory_bus);
 
+    // Runs one instruction on the interpreter
     int Tick();
+    // Runs one instruction, or with the block cache on, cached code
+    // until about budget cycles have passed or something needs
+    // attention between instructions; the scheduler is advanced
+    // as it goes and the cycles run are returned
+    int Run(int budget)
+    {
+        if(use_block_cache)
+            return RunCached(budget);
+        int cycles = Tick();
+        scheduler.Advance(cycles);
+        return cycles;
+    }
 
+    // OAM DMA; the copy lands once the transfer's time is up
     void StartDMATransfer(u8 addrH);
+    void FinishDMATransfer();
+
+    // Entry in the opcode dispatch tables
+    typedef MicroOpHandler OpcodeHandler;
+    // Handlers that take their operand from a decoded MicroOp
+    static const OpcodeHandler* GetDecodedHandlers();
+    static const OpcodeHandler* GetCBHandlers();
+
+    int ExecuteNext()
+        { return (this->*interpret)(); }
 
-    // fetches operand and increments PC
-    u8 GetOperand8();
-    u16 GetOperand16();
+    // Records every instruction to the tracer from now on,
+    // or stops tracing if it is null; traced code always
+    // runs on the interpreter
+    void SetTracer(Debug::Tracer* tracer);
 
-    int ExecuteNext();
-    u8 ExecuteCBOpcode();
+    BlockCache& GetBlockCache()
+        { return block_cache; }
+    Recompiler& GetRecompiler()
+        { return recompiler; }
+    IdleLoopDetector& GetIdleLoops()
+        { return idle_loops; }
+    bool IsHalted()
+        { return halted; }
+    u64 GetHaltedCycles()
+        { return halted_cycles; }
+    // F with any pending flags worked out
+    u8 GetF() const;
+    ProcessorState& GetState()
+        { return *this; }
+    void SetState(const ProcessorState& state)
+        { static_cast<ProcessorState&>(*this) = state; }
 
     // Instructions
     // load
@@ -123,9 +279,9 @@ public:
     void daa();
     // compare
     void cp(u8 value);
-    // jump
-    void jr(s8 amt);
-    void jp(u16 addr);
+    // jump; these return any cycles skipped in an idle loop
+    int jr(s8 amt);
+    int jp(u16 addr);
     void call(u16 addr);
     void ret();
     // stack
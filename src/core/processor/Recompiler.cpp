@@ -0,0 +1,708 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "Recompiler.h"
+#include "Opcodes.h"
+#include "Processor.h"
+#include "../GameBoy.h"
+#include "../memory/MemoryBus.h"
+
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#endif
+
+
+#if defined(__x86_64__)
+
+// Host registers; compiled code keeps the CPU in RBX, the frame in
+// R12, its cycle count in R13D, &Scheduler::now in R14 and the bus
+// read page table in R15, all of which survive calls
+enum HostRegister
+{
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3,
+    RSI = 6, RDI = 7,
+    R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+enum Condition : u8
+{
+    COND_AE = 0x3,
+    COND_E = 0x4,
+    COND_NE = 0x5,
+    COND_GE = 0xD
+};
+
+// Only called on pages the page tables leave to a handler
+static u8 ReadBus(Memory::MemoryBus* bus, u16 address)
+{
+    return bus->Read8(address);
+}
+
+static void WriteBus(Memory::MemoryBus* bus, u16 address, u8 data)
+{
+    bus->Write8(address, data);
+}
+
+// Assembles the few instruction forms compiled code needs
+class Emitter
+{
+public:
+    std::vector<u8> bytes;
+
+    void Byte(u8 value)
+        { bytes.push_back(value); }
+    void Word(u16 value)
+        { Byte(value & 0xFF); Byte(value >> 8); }
+    void Dword(u32 value)
+        { Word(value & 0xFFFF); Word(value >> 16); }
+    void Qword(u64 value)
+        { Dword(value & 0xFFFFFFFF); Dword(value >> 32); }
+    u32 Position()
+        { return static_cast<u32>(bytes.size()); }
+
+    // Left out when it would carry nothing
+    void Rex(bool wide, int reg, int base, int index = 0)
+    {
+        u8 rex = 0x40 | (wide? 0x08 : 0) | ((reg & 8)? 0x04 : 0) |
+                 ((index & 8)? 0x02 : 0) | ((base & 8)? 0x01 : 0);
+        if(rex != 0x40)
+            Byte(rex);
+    }
+
+    // op reg, [base + disp]
+    void MemOp(std::initializer_list<u8> opcode, int reg, int base, s32 disp, bool wide = false, bool word = false)
+    {
+        if(word)
+            Byte(0x66);
+        Rex(wide, reg, base);
+        for(u8 b : opcode)
+            Byte(b);
+        bool short_disp = (disp >= -128 && disp < 128);
+        Byte((short_disp? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+        // RSP and R12 can only be a base through a SIB byte
+        if((base & 7) == 4)
+            Byte(0x24);
+        Displacement(disp);
+    }
+    // op reg, [base + index * 8 + disp]
+    void MemIndexOp(std::initializer_list<u8> opcode, int reg, int base, int index, s32 disp, bool wide = false)
+    {
+        Rex(wide, reg, base, index);
+        for(u8 b : opcode)
+            Byte(b);
+        bool short_disp = (disp >= -128 && disp < 128);
+        Byte((short_disp? 0x44 : 0x84) | ((reg & 7) << 3));
+        Byte(0xC0 | ((index & 7) << 3) | (base & 7));
+        Displacement(disp);
+    }
+    // 8 bits where they will do, otherwise 32
+    void Displacement(s32 disp)
+    {
+        if(disp >= -128 && disp < 128)
+            Byte(static_cast<u8>(disp));
+        else
+            Dword(disp);
+    }
+    // op rm, reg
+    void RegOp(std::initializer_list<u8> opcode, int reg, int rm, bool wide = false)
+    {
+        Rex(wide, reg, rm);
+        for(u8 b : opcode)
+            Byte(b);
+        Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void Push(int reg)
+        { if(reg & 8) Byte(0x41); Byte(0x50 | (reg & 7)); }
+    void Pop(int reg)
+        { if(reg & 8) Byte(0x41); Byte(0x58 | (reg & 7)); }
+    void MovImm64(int reg, u64 value)
+        { Rex(true, 0, reg); Byte(0xB8 | (reg & 7)); Qword(value); }
+    void MovImm32(int reg, u32 value)
+        { Rex(false, 0, reg); Byte(0xB8 | (reg & 7)); Dword(value); }
+    void CallAbsolute(const void* function)
+    {
+        MovImm64(RAX, reinterpret_cast<u64>(function));
+        Byte(0xFF);
+        Byte(0xD0);
+    }
+
+    // Jumps with a 32-bit displacement that Bind fills in
+    u32 Jump(Condition condition)
+        { Byte(0x0F); Byte(0x80 | condition); Dword(0); return Position(); }
+    u32 Jump()
+        { Byte(0xE9); Dword(0); return Position(); }
+    void Bind(u32 jump, u32 target)
+    {
+        u32 displacement = target - jump;
+        std::memcpy(&bytes[jump - 4], &displacement, 4);
+    }
+    void Bind(u32 jump)
+        { Bind(jump, Position()); }
+};
+
+// Where compiled code finds everything, relative to RBX, R12 or R14
+struct Layout
+{
+    s32 r8[8];
+    s32 r16[4];
+    s32 pc;
+    s32 operand;
+    s32 ime;
+    s32 ie;
+    s32 iflag;
+    // lazy_flags members
+    s32 flag_op;
+    s32 flag_mask;
+    s32 flag_a;
+    s32 flag_b;
+    s32 flag_carry;
+    s32 next;
+    s32 write_pages;
+};
+
+// What an instruction compiled inline can disturb
+enum InlineKind
+{
+    // Not compiled; calls its handler
+    INLINE_NONE,
+    // Only touches registers, so nothing between
+    // instructions can change but the time
+    INLINE_REGISTERS,
+    // Goes to memory or IME, so anything can
+    INLINE_SIDE_EFFECTS
+};
+
+// Puts the address an instruction goes to in ESI
+static void EmitAddress(Emitter& e, const Layout& layout, const Core::MicroOp& op)
+{
+    switch(op.opcode)
+    {
+    case 0x02: case 0x0A:
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[0]); break;
+    case 0x12: case 0x1A:
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[1]); break;
+    case 0xE0: case 0xF0:
+        e.MovImm32(RSI, 0xFF00 + (op.operand & 0xFF)); break;
+    case 0xEA: case 0xFA:
+        e.MovImm32(RSI, op.operand); break;
+    case 0xE2: case 0xF2:
+        // OR ESI, 0xFF00
+        e.MemOp({0x0F, 0xB6}, RSI, RBX, layout.r8[1]);
+        e.RegOp({0x81}, 1, RSI);
+        e.Dword(0xFF00);
+        break;
+    default:
+        // (HL), (HL+) and (HL-)
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[2]); break;
+    }
+}
+
+// Reads the byte at ESI into EAX, straight out of its
+// page if it has one and through the bus if not
+static void EmitRead(Emitter& e, Memory::MemoryBus* bus)
+{
+    e.RegOp({0x89}, RSI, RAX);                      // mov eax, esi
+    e.Byte(0xC1); e.Byte(0xE8); e.Byte(8);          // shr eax, 8
+    e.MemIndexOp({0x8B}, RDX, R15, RAX, 0, true);   // mov rdx, [r15 + rax * 8]
+    e.RegOp({0x85}, RDX, RDX, true);                // test rdx, rdx
+    u32 slow = e.Jump(COND_E);
+    e.RegOp({0x89}, RSI, RAX);                      // mov eax, esi
+    e.RegOp({0x0F, 0xB6}, RAX, RAX);                // movzx eax, al
+    e.Byte(0x0F); e.Byte(0xB6); e.Byte(0x04); e.Byte(0x02);     // movzx eax, byte [rdx + rax]
+    u32 done = e.Jump();
+    e.Bind(slow);
+    e.MovImm64(RDI, reinterpret_cast<u64>(bus));
+    e.CallAbsolute(reinterpret_cast<const void*>(&ReadBus));
+    e.RegOp({0x0F, 0xB6}, RAX, RAX);                // movzx eax, al
+    e.Bind(done);
+}
+
+// Writes DL to the byte at ESI, the same way
+static void EmitWrite(Emitter& e, const Layout& layout, Memory::MemoryBus* bus)
+{
+    e.RegOp({0x89}, RSI, RAX);                      // mov eax, esi
+    e.Byte(0xC1); e.Byte(0xE8); e.Byte(8);          // shr eax, 8
+    e.MemIndexOp({0x8B}, RCX, R15, RAX, layout.write_pages, true);
+    e.RegOp({0x85}, RCX, RCX, true);                // test rcx, rcx
+    u32 slow = e.Jump(COND_E);
+    e.RegOp({0x89}, RSI, RAX);                      // mov eax, esi
+    e.RegOp({0x0F, 0xB6}, RAX, RAX);                // movzx eax, al
+    e.Byte(0x88); e.Byte(0x14); e.Byte(0x01);       // mov [rcx + rax], dl
+    u32 done = e.Jump();
+    e.Bind(slow);
+    e.MovImm64(RDI, reinterpret_cast<u64>(bus));
+    e.CallAbsolute(reinterpret_cast<const void*>(&WriteBus));
+    e.Bind(done);
+}
+
+// Records a pending flag operation with A in AL and the
+// operand in CL, as Processor::DeferFlags does
+static void EmitDeferFlags(Emitter& e, const Layout& layout, Core::ProcessorState::FlagOp op, u8 mask, bool operand)
+{
+    e.MemOp({0xC6}, 0, RBX, layout.flag_op);
+    e.Byte(op);
+    e.MemOp({0xC6}, 0, RBX, layout.flag_mask);
+    e.Byte(mask);
+    e.MemOp({0x88}, RAX, RBX, layout.flag_a);
+    if(operand)
+        e.MemOp({0x88}, RCX, RBX, layout.flag_b);
+    else
+    {
+        e.MemOp({0xC6}, 0, RBX, layout.flag_b);
+        e.Byte(0);
+    }
+    e.MemOp({0xC6}, 0, RBX, layout.flag_carry);
+    e.Byte(0);
+}
+
+// ADD, SUB, AND, XOR, OR or CP of A and ECX
+static bool EmitALU(Emitter& e, const Layout& layout, int operation)
+{
+    typedef Core::ProcessorState State;
+    e.MemOp({0x0F, 0xB6}, RAX, RBX, layout.r8[7]);
+    switch(operation)
+    {
+    case 0:
+        EmitDeferFlags(e, layout, State::FLAGS_ADD, 0xF0, true);
+        e.RegOp({0x00}, RCX, RAX);                  // add al, cl
+        break;
+    case 2:
+    case 7:
+        EmitDeferFlags(e, layout, State::FLAGS_SUB, 0xF0, true);
+        // CP only sets the flags
+        if(operation == 7)
+            return true;
+        e.RegOp({0x28}, RCX, RAX);                  // sub al, cl
+        break;
+    case 4:
+        e.RegOp({0x20}, RCX, RAX);                  // and al, cl
+        EmitDeferFlags(e, layout, State::FLAGS_AND, 0xF0, false);
+        break;
+    case 5:
+        e.RegOp({0x30}, RCX, RAX);                  // xor al, cl
+        EmitDeferFlags(e, layout, State::FLAGS_OR, 0xF0, false);
+        break;
+    case 6:
+        e.RegOp({0x08}, RCX, RAX);                  // or al, cl
+        EmitDeferFlags(e, layout, State::FLAGS_OR, 0xF0, false);
+        break;
+    default:
+        // ADC and SBC read the carry, so they stay with the handlers
+        return false;
+    }
+    e.MemOp({0x88}, RAX, RBX, layout.r8[7]);
+    return true;
+}
+
+// Compiles op inline if it is one of the simple loads, moves
+// and ALU operations, leaving its cycle count in EAX
+static InlineKind EmitInline(Emitter& e, const Layout& layout, Memory::MemoryBus* bus, const Core::MicroOp& op)
+{
+    u8 opcode = op.opcode;
+    int dst = (opcode >> 3) & 7;
+    int src = opcode & 7;
+    InlineKind kind = INLINE_REGISTERS;
+
+    if(opcode == 0x00)
+    {
+        // NOP
+    }
+    else if(opcode >= 0x40 && opcode < 0x80 && opcode != 0x76)
+    {
+        if(src == 6)
+        {
+            // LD r, (HL)
+            EmitAddress(e, layout, op);
+            EmitRead(e, bus);
+            e.MemOp({0x88}, RAX, RBX, layout.r8[dst]);
+            kind = INLINE_SIDE_EFFECTS;
+        }
+        else if(dst == 6)
+        {
+            // LD (HL), r
+            EmitAddress(e, layout, op);
+            e.MemOp({0x0F, 0xB6}, RDX, RBX, layout.r8[src]);
+            EmitWrite(e, layout, bus);
+            kind = INLINE_SIDE_EFFECTS;
+        }
+        else
+        {
+            // LD r, r'
+            e.MemOp({0x0F, 0xB6}, RAX, RBX, layout.r8[src]);
+            e.MemOp({0x88}, RAX, RBX, layout.r8[dst]);
+        }
+    }
+    else if((opcode & 0xC7) == 0x06 && opcode != 0x36)
+    {
+        // LD r, n
+        e.MemOp({0xC6}, 0, RBX, layout.r8[dst]);
+        e.Byte(op.operand & 0xFF);
+    }
+    else if(opcode == 0x36)
+    {
+        // LD (HL), n
+        EmitAddress(e, layout, op);
+        e.MovImm32(RDX, op.operand & 0xFF);
+        EmitWrite(e, layout, bus);
+        kind = INLINE_SIDE_EFFECTS;
+    }
+    else if((opcode & 0xCF) == 0x01)
+    {
+        // LD rr, nn
+        e.MemOp({0xC7}, 0, RBX, layout.r16[opcode >> 4], false, true);
+        e.Word(op.operand);
+    }
+    else if((opcode & 0xC7) == 0x03)
+    {
+        // INC rr and DEC rr
+        e.MemOp({0xFF}, (opcode & 0x08)? 1 : 0, RBX, layout.r16[opcode >> 4], false, true);
+    }
+    else if(opcode == 0xF9)
+    {
+        // LD SP, HL
+        e.MemOp({0x8B}, RAX, RBX, layout.r16[2], false, true);
+        e.MemOp({0x89}, RAX, RBX, layout.r16[3], false, true);
+    }
+    else if(opcode == 0xF3 || opcode == 0xFB)
+    {
+        // DI and EI
+        e.MemOp({0xC6}, 0, RBX, layout.ime);
+        e.Byte((opcode == 0xFB)? 1 : 0);
+        if(opcode == 0xFB)
+            kind = INLINE_SIDE_EFFECTS;
+    }
+    else if(opcode == 0x0A || opcode == 0x1A || opcode == 0x2A || opcode == 0x3A ||
+            opcode == 0xF0 || opcode == 0xF2 || opcode == 0xFA)
+    {
+        // LD A, (BC), (DE), (HL+), (HL-), (n), (C) and (nn)
+        EmitAddress(e, layout, op);
+        EmitRead(e, bus);
+        e.MemOp({0x88}, RAX, RBX, layout.r8[7]);
+        kind = INLINE_SIDE_EFFECTS;
+    }
+    else if(opcode == 0x02 || opcode == 0x12 || opcode == 0x22 || opcode == 0x32 ||
+            opcode == 0xE0 || opcode == 0xE2 || opcode == 0xEA)
+    {
+        // LD (BC), (DE), (HL+), (HL-), (n), (C) and (nn), A
+        EmitAddress(e, layout, op);
+        e.MemOp({0x0F, 0xB6}, RDX, RBX, layout.r8[7]);
+        EmitWrite(e, layout, bus);
+        kind = INLINE_SIDE_EFFECTS;
+    }
+    else if(opcode >= 0x80 && opcode < 0xC0 && ((opcode >> 3) & 7) != 1 && ((opcode >> 3) & 7) != 3)
+    {
+        // ALU A, r and ALU A, (HL)
+        if(src == 6)
+        {
+            EmitAddress(e, layout, op);
+            EmitRead(e, bus);
+            e.RegOp({0x89}, RAX, RCX);              // mov ecx, eax
+            kind = INLINE_SIDE_EFFECTS;
+        }
+        else
+            e.MemOp({0x0F, 0xB6}, RCX, RBX, layout.r8[src]);
+        EmitALU(e, layout, dst);
+    }
+    else if((opcode & 0xC7) == 0xC6 && dst != 1 && dst != 3)
+    {
+        // ALU A, n
+        e.MovImm32(RCX, op.operand & 0xFF);
+        EmitALU(e, layout, dst);
+    }
+    else if((opcode & 0xC6) == 0x04 && dst != 6)
+    {
+        // INC r and DEC r only own Z, N and H, so a pending
+        // carry has to be worked out first
+        e.MemOp({0xF6}, 0, RBX, layout.flag_mask);  // test byte [mask], 0x10
+        e.Byte(0x10);
+        u32 settled = e.Jump(COND_E);
+        e.RegOp({0x89}, RBX, RDI, true);            // mov rdi, rbx
+        e.CallAbsolute(reinterpret_cast<const void*>(&Core::Recompiler::SyncFlags));
+        e.Bind(settled);
+        e.MemOp({0x0F, 0xB6}, RAX, RBX, layout.r8[dst]);
+        bool inc = (opcode & 1) == 0;
+        EmitDeferFlags(e, layout, inc? Core::ProcessorState::FLAGS_INC : Core::ProcessorState::FLAGS_DEC, 0xE0, false);
+        e.RegOp({0xFE}, inc? 0 : 1, RAX);           // inc al / dec al
+        e.MemOp({0x88}, RAX, RBX, layout.r8[dst]);
+    }
+    else if(opcode == 0xC5 || opcode == 0xD5 || opcode == 0xE5)
+    {
+        // PUSH rr, low byte first as Write16 does
+        s32 pair = layout.r16[(opcode >> 4) & 3];
+        e.MemOp({0x83}, 5, RBX, layout.r16[3], false, true);   // sub word [sp], 2
+        e.Byte(2);
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[3]);
+        e.MemOp({0x0F, 0xB6}, RDX, RBX, pair);
+        EmitWrite(e, layout, bus);
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[3]);
+        e.RegOp({0xFF}, 0, RSI);                    // inc esi
+        e.RegOp({0x0F, 0xB7}, RSI, RSI);            // movzx esi, si
+        e.MemOp({0x0F, 0xB6}, RDX, RBX, pair + 1);
+        EmitWrite(e, layout, bus);
+        kind = INLINE_SIDE_EFFECTS;
+    }
+    else if(opcode == 0xC1 || opcode == 0xD1 || opcode == 0xE1)
+    {
+        // POP rr
+        s32 pair = layout.r16[(opcode >> 4) & 3];
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[3]);
+        EmitRead(e, bus);
+        e.MemOp({0x88}, RAX, RBX, pair);
+        e.MemOp({0x0F, 0xB7}, RSI, RBX, layout.r16[3]);
+        e.RegOp({0xFF}, 0, RSI);                    // inc esi
+        e.RegOp({0x0F, 0xB7}, RSI, RSI);            // movzx esi, si
+        EmitRead(e, bus);
+        e.MemOp({0x88}, RAX, RBX, pair + 1);
+        e.MemOp({0x83}, 0, RBX, layout.r16[3], false, true);   // add word [sp], 2
+        e.Byte(2);
+        kind = INLINE_SIDE_EFFECTS;
+    }
+    else
+        return INLINE_NONE;
+
+    // HL moves on after (HL+) and (HL-)
+    if(opcode == 0x22 || opcode == 0x2A)
+        e.MemOp({0xFF}, 0, RBX, layout.r16[2], false, true);
+    else if(opcode == 0x32 || opcode == 0x3A)
+        e.MemOp({0xFF}, 1, RBX, layout.r16[2], false, true);
+
+    e.MovImm32(RAX, OPCODE_LOOKUP[opcode].cycles);
+    return kind;
+}
+
+#endif
+
+
+namespace Core {
+
+Recompiler::Recompiler(GameBoy* gameboy,
+                       Processor* processor,
+                       std::shared_ptr<Memory::MemoryBus>& memory_bus)
+:
+    gameboy (gameboy),
+    processor (processor),
+    memory_bus (memory_bus)
+{
+#if defined(__x86_64__)
+    // Only systems that asked for it take an executable buffer
+    if(!gameboy->GetOptions().jit)
+        return;
+    void* buffer = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buffer != MAP_FAILED)
+        code = static_cast<u8*>(buffer);
+#endif
+}
+
+Recompiler::~Recompiler()
+{
+#if defined(__x86_64__)
+    if(code != nullptr)
+        munmap(code, CODE_SIZE);
+#endif
+}
+
+void Recompiler::SyncFlags(Processor* cpu)
+{
+    cpu->SyncFlags();
+}
+
+CompiledBlock Recompiler::Compile(const Block& block)
+{
+#if defined(__x86_64__)
+    if(code == nullptr)
+        return nullptr;
+
+    Memory::MemoryBus* bus = memory_bus.get();
+    Scheduler& scheduler = gameboy->GetScheduler();
+
+    // The state sits at the same place in every Processor
+    const ProcessorState* state = processor;
+    s32 base = static_cast<s32>(reinterpret_cast<const u8*>(state) - reinterpret_cast<const u8*>(processor));
+    Layout layout;
+    for(int field = 0; field < 8; field++)
+        layout.r8[field] = base + offsetof(ProcessorState, r8) + R8Index(field);
+    layout.r16[0] = base + offsetof(ProcessorState, reg_BC);
+    layout.r16[1] = base + offsetof(ProcessorState, reg_DE);
+    layout.r16[2] = base + offsetof(ProcessorState, reg_HL);
+    layout.r16[3] = base + offsetof(ProcessorState, reg_SP);
+    layout.pc = base + offsetof(ProcessorState, reg_PC);
+    layout.operand = base + offsetof(ProcessorState, operand);
+    layout.ime = base + offsetof(ProcessorState, IME);
+    layout.ie = base + offsetof(ProcessorState, IE);
+    layout.iflag = base + offsetof(ProcessorState, IF);
+    layout.flag_op = base + offsetof(ProcessorState, lazy_flags.op);
+    layout.flag_mask = base + offsetof(ProcessorState, lazy_flags.mask);
+    layout.flag_a = base + offsetof(ProcessorState, lazy_flags.a);
+    layout.flag_b = base + offsetof(ProcessorState, lazy_flags.b);
+    layout.flag_carry = base + offsetof(ProcessorState, lazy_flags.carry);
+    layout.next = static_cast<s32>(reinterpret_cast<u8*>(&scheduler.next) - reinterpret_cast<u8*>(&scheduler.now));
+    layout.write_pages = static_cast<s32>(reinterpret_cast<u8*>(bus->write_pages) - reinterpret_cast<u8*>(bus->read_pages));
+
+    Emitter e;
+    e.Push(RBX);
+    e.Push(R12);
+    e.Push(R13);
+    e.Push(R14);
+    e.Push(R15);
+    e.RegOp({0x89}, RDI, RBX, true);                // mov rbx, rdi
+    e.RegOp({0x89}, RSI, R12, true);                // mov r12, rsi
+    e.RegOp({0x31}, R13, R13);                      // xor r13d, r13d
+    e.MovImm64(R14, reinterpret_cast<u64>(&scheduler.now));
+    e.MovImm64(R15, reinterpret_cast<u64>(bus->read_pages));
+
+    // Early ways out, filled in after the body
+    struct Exit
+    {
+        u32 jump;
+        size_t index;
+        // Stopped for an interrupt before its cycles were counted
+        bool interrupt;
+    };
+    std::vector<Exit> exits;
+
+    size_t count = block.ops.size();
+    bool handled_last = false;
+    for(size_t i = 0; i < count; i++)
+    {
+        const MicroOp& op = block.ops[i];
+        bool last = (i + 1 == count);
+
+        InlineKind kind = EmitInline(e, layout, bus, op);
+        if(kind == INLINE_NONE)
+        {
+            e.MemOp({0xC7}, 0, RBX, layout.pc, false, true);
+            e.Word(op.address + op.length);
+            if(op.length > 1 && op.opcode != 0xCB)
+            {
+                e.MemOp({0xC7}, 0, RBX, layout.operand, false, true);
+                e.Word(op.operand);
+            }
+            e.RegOp({0x89}, RBX, RDI, true);        // mov rdi, rbx
+            e.CallAbsolute(reinterpret_cast<const void*>(op.handler));
+            e.RegOp({0x89}, RAX, RAX);              // mov eax, eax
+            stats.handler_instructions++;
+            handled_last = last;
+        }
+        else
+            stats.inline_instructions++;
+
+        // Nothing but the first instruction and ones with side effects
+        // can find an interrupt pending that the last one didn't
+        if(i == 0 || kind != INLINE_REGISTERS)
+        {
+            e.MemOp({0x80}, 7, RBX, layout.ime);    // cmp byte [ime], 0
+            e.Byte(0);
+            u32 disabled = e.Jump(COND_E);
+            e.MemOp({0x0F, 0xB6}, RCX, RBX, layout.ie);
+            e.MemOp({0x22}, RCX, RBX, layout.iflag);
+            e.Byte(0xF6); e.Byte(0xC1); e.Byte(0x1F);  // test cl, 0x1F
+            exits.push_back({ e.Jump(COND_NE), i, true });
+            e.Bind(disabled);
+        }
+
+        e.RegOp({0x01}, RAX, R13);                  // add r13d, eax
+        e.MemOp({0x01}, RAX, R14, 0, true);         // add [r14], rax
+        if(last)
+            break;
+
+        // Out of budget or an event is due
+        e.MemOp({0x3B}, R13, R12, offsetof(JitFrame, budget));
+        exits.push_back({ e.Jump(COND_GE), i, false });
+        e.MemOp({0x8B}, RAX, R14, 0, true);
+        e.MemOp({0x3B}, RAX, R14, layout.next, true);
+        exits.push_back({ e.Jump(COND_AE), i, false });
+        if(kind != INLINE_REGISTERS)
+        {
+            // P1 was written or the ROM bank switched
+            e.MovImm64(RAX, reinterpret_cast<u64>(&gameboy->keys_dirty));
+            e.MemOp({0x80}, 7, RAX, 0);
+            e.Byte(0);
+            exits.push_back({ e.Jump(COND_NE), i, false });
+            e.MovImm64(RAX, reinterpret_cast<u64>(&bus->bank_switches));
+            e.MemOp({0x8B}, RAX, RAX, 0);
+            e.MemOp({0x3B}, RAX, R12, offsetof(JitFrame, generation));
+            exits.push_back({ e.Jump(COND_NE), i, false });
+        }
+    }
+
+    // Ran the whole block; a handler at the end has set PC itself
+    const MicroOp& end = block.ops.back();
+    if(!handled_last)
+    {
+        e.MemOp({0xC7}, 0, RBX, layout.pc, false, true);
+        e.Word(end.address + end.length);
+    }
+    e.MemOp({0xC7}, 0, R12, offsetof(JitFrame, executed));
+    e.Dword(static_cast<u32>(count));
+
+    u32 epilogue = e.Position();
+    e.RegOp({0x89}, R13, RAX);                      // mov eax, r13d
+    e.Pop(R15);
+    e.Pop(R14);
+    e.Pop(R13);
+    e.Pop(R12);
+    e.Pop(RBX);
+    e.Byte(0xC3);
+
+    // Exits are recorded in order, so each run of them from the
+    // same instruction for the same reason can share a stub
+    for(size_t i = 0; i < exits.size(); i++)
+    {
+        const Exit& exit = exits[i];
+        const MicroOp& op = block.ops[exit.index];
+        e.Bind(exit.jump);
+        while(i + 1 < exits.size() && exits[i + 1].index == exit.index &&
+              exits[i + 1].interrupt == exit.interrupt)
+            e.Bind(exits[++i].jump);
+        if(exit.interrupt)
+            e.MemOp({0x89}, RAX, R12, offsetof(JitFrame, pending));
+        if(!(handled_last && exit.index + 1 == count))
+        {
+            e.MemOp({0xC7}, 0, RBX, layout.pc, false, true);
+            e.Word(op.address + op.length);
+        }
+        e.MemOp({0xC7}, 0, R12, offsetof(JitFrame, executed));
+        e.Dword(static_cast<u32>(exit.index + 1));
+        e.Bind(e.Jump(), epilogue);
+    }
+
+    // Keep each block on a 16-byte boundary
+    u32 size = (e.Position() + 15) & ~15;
+    if(code_used + size > CODE_SIZE)
+    {
+        stats.overflows++;
+        return nullptr;
+    }
+    u8* entry = code + code_used;
+    std::memcpy(entry, e.bytes.data(), e.Position());
+    code_used += size;
+
+    stats.blocks++;
+    stats.code_bytes = code_used;
+    return reinterpret_cast<CompiledBlock>(entry);
+#else
+    (void)block;
+    return nullptr;
+#endif
+}
+
+}; // namespace Core
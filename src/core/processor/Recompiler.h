@@ -0,0 +1,106 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "BlockCache.h"
+
+#include "../../common/Types.h"
+
+#include <memory>
+
+
+namespace Memory {
+    class MemoryBus;
+}; // namespace Memory
+
+namespace Core {
+class GameBoy;
+class Processor;
+
+// Passed to compiled code, which reports back where it stopped
+struct JitFrame
+{
+    // Cycles the block may run before it has to stop
+    int budget;
+    // Bank switch count the run started under
+    u32 generation;
+    // Instructions run
+    u32 executed;
+    // Cycles of the last one, if it stopped with an interrupt
+    // pending; the scheduler hasn't been advanced by them
+    int pending;
+};
+
+// Translates hot blocks to x86-64 code. Loads, stores, PUSH/POP,
+// 16-bit register arithmetic and the ALU operations with lazy
+// flags are compiled inline, with memory going through the bus
+// page tables; everything else calls the block cache's handler
+// for it. Between instructions the code checks
+// for everything RunBlocks does, so it can stop at the same point
+// the interpreter would. Elsewhere Compile always fails.
+class Recompiler
+{
+public:
+    // Entries from the start before a block is compiled
+    static const u32 HOT_ENTRIES = 16;
+
+    struct Stats
+    {
+        // Blocks compiled and bytes of the buffer in use
+        u32 blocks = 0;
+        u32 code_bytes = 0;
+        // Instructions compiled inline versus as handler calls
+        u32 inline_instructions = 0;
+        u32 handler_instructions = 0;
+        // Times the code buffer filled up and was cleared
+        u32 overflows = 0;
+    };
+
+    Recompiler(GameBoy* gameboy,
+               Processor* processor,
+               std::shared_ptr<Memory::MemoryBus>& memory_bus);
+    ~Recompiler();
+
+    // Whether compiled code can run on this host
+    bool IsAvailable()
+        { return code != nullptr; }
+    // Returns host code for the block, or nullptr if the
+    // buffer is full and has to be cleared first
+    CompiledBlock Compile(const Block& block);
+    // Throws away all compiled code
+    void Clear()
+        { code_used = 0; }
+
+    Stats& GetStats()
+        { return stats; }
+
+    // Called from compiled code
+    static void SyncFlags(Processor* cpu);
+
+private:
+    static const u32 CODE_SIZE = 4 << 20;
+
+    // Executable buffer compiled blocks are appended to
+    u8* code = nullptr;
+    u32 code_used = 0;
+
+    GameBoy* gameboy;
+    Processor* processor;
+    std::shared_ptr<Memory::MemoryBus> memory_bus;
+
+    Stats stats;
+};
+
+}; // namespace Core
@@ -0,0 +1,174 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Lockstep.h"
+#include "Logger.h"
+
+#include "../core/processor/Processor.h"
+#include "../core/memory/MemoryBus.h"
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+
+// Regions of writable memory that are compared
+static const struct
+{
+    u16 base;
+    u16 size;
+} MEMORY_REGIONS[] = {
+    { 0x8000, 0x2000 }, // VRAM
+    { 0xA000, 0x2000 }, // cartridge RAM
+    { 0xC000, 0x2000 }, // WRAM
+    { 0xFE00, 0x00A0 }, // OAM
+    { 0xFF80, 0x007F }  // HRAM
+};
+
+
+namespace Debug {
+
+Lockstep::Lockstep(Core::GameBoy::Options& options,
+                   int width,
+                   int height,
+                   std::unique_ptr<Core::RomImage> rom,
+                   const std::vector<u8>& bootrom)
+{
+    // Tracing bypasses the block cache, so it stays off on both
+    Core::GameBoy::Options cached_options = options;
+    cached_options.debug = false;
+    cached_options.block_cache = true;
+    Core::GameBoy::Options interpreter_options = cached_options;
+    interpreter_options.block_cache = false;
+    interpreter_options.jit = false;
+    // Only one of them can have the screen
+    interpreter_options.headless = true;
+
+    // The interpreter runs off its own in-memory copy of the cartridge
+    std::vector<u8> copy;
+    for(u32 bank = 0; bank < rom->GetBanks(); bank++)
+    {
+        const u8* data = rom->GetBank(bank);
+        copy.insert(copy.end(), data, data + Core::RomImage::BANK_SIZE);
+    }
+    std::unique_ptr<Core::RomImage> interpreter_rom (new Core::RomImage(std::move(copy)));
+
+    cached = std::unique_ptr<Core::GameBoy> (new Core::GameBoy(cached_options, width, height, std::move(rom), bootrom));
+    interpreter = std::unique_ptr<Core::GameBoy> (new Core::GameBoy(interpreter_options, width, height, std::move(interpreter_rom), bootrom));
+}
+
+bool Lockstep::Step()
+{
+    if(diverged)
+        return false;
+
+    // The block cache runs several instructions per step, so
+    // the interpreter goes one at a time until it catches up
+    cached->Cycle();
+    u64 now = cached->GetScheduler().GetNow();
+    while(interpreter->GetScheduler().GetNow() < now && !interpreter->IsStopped())
+        interpreter->Cycle();
+    steps++;
+
+    if(!CompareCycles() || !CompareRegisters() || !CompareMemory())
+    {
+        diverged = true;
+        LOG_MSG("Block cache registers:");
+        Logger::LogRegisters(*cached->GetProcessor());
+        LOG_MSG("Interpreter registers:");
+        Logger::LogRegisters(*interpreter->GetProcessor());
+        cached->Stop();
+        interpreter->Stop();
+        return false;
+    }
+    return true;
+}
+
+bool Lockstep::CompareCycles()
+{
+    u64 a = cached->GetScheduler().GetNow();
+    u64 b = interpreter->GetScheduler().GetNow();
+    if(a == b)
+        return true;
+
+    char msg[96];
+    std::snprintf(msg, sizeof(msg), "Lockstep: cycles diverged after %u steps: %llu (cache) vs %llu (interpreter)",
+                  static_cast<unsigned>(steps), static_cast<unsigned long long>(a), static_cast<unsigned long long>(b));
+    LOG_ERROR(std::string(msg));
+    return false;
+}
+
+bool Lockstep::CompareRegisters()
+{
+    const Core::Processor& a = *cached->GetProcessor();
+    const Core::Processor& b = *interpreter->GetProcessor();
+
+    const struct
+    {
+        const char* name;
+        u16 a;
+        u16 b;
+    } registers[] = {
+        { "AF", static_cast<u16>((a.reg_A << 8) | a.GetF()), static_cast<u16>((b.reg_A << 8) | b.GetF()) },
+        { "BC", a.reg_BC.word, b.reg_BC.word },
+        { "DE", a.reg_DE.word, b.reg_DE.word },
+        { "HL", a.reg_HL.word, b.reg_HL.word },
+        { "SP", a.reg_SP.word, b.reg_SP.word },
+        { "PC", a.reg_PC.word, b.reg_PC.word },
+        { "IME", a.IME, b.IME },
+        { "IE", a.IE, b.IE },
+        { "IF", a.IF, b.IF }
+    };
+
+    for(auto& reg : registers)
+    {
+        if(reg.a != reg.b)
+        {
+            char msg[96];
+            std::snprintf(msg, sizeof(msg), "Lockstep: %s diverged after %u steps: %04Xh (cache) vs %04Xh (interpreter)",
+                          reg.name, static_cast<unsigned>(steps), reg.a, reg.b);
+            LOG_ERROR(std::string(msg));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Lockstep::CompareMemory()
+{
+    static u8 a[0x2000];
+    static u8 b[0x2000];
+
+    for(auto& region : MEMORY_REGIONS)
+    {
+        // Read the pages directly so IO reads can't interfere
+        cached->GetMemoryBus()->ReadBytes(a, region.base, region.size);
+        interpreter->GetMemoryBus()->ReadBytes(b, region.base, region.size);
+
+        for(int i = 0; i < region.size; i++)
+        {
+            if(a[i] != b[i])
+            {
+                char msg[96];
+                std::snprintf(msg, sizeof(msg), "Lockstep: memory at %04Xh diverged after %u steps: %02Xh (cache) vs %02Xh (interpreter)",
+                              region.base + i, static_cast<unsigned>(steps), a[i], b[i]);
+                LOG_ERROR(std::string(msg));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}; // namespace Debug
@@ -0,0 +1,63 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../core/GameBoy.h"
+
+#include "../common/Types.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace Debug {
+
+// Runs the block cache (and with jit set, the recompiler) and
+// the interpreter side by side on two systems and stops at the
+// first step after which their cycle counts, registers or
+// memory no longer match
+class Lockstep
+{
+public:
+    Lockstep(Core::GameBoy::Options& options,
+             int width,
+             int height,
+             std::unique_ptr<Core::RomImage> rom,
+             const std::vector<u8>& bootrom);
+
+    // Steps both systems; returns false once they diverged
+    bool Step();
+
+    bool HasDiverged()
+        { return diverged; }
+    u32 GetSteps()
+        { return steps; }
+    // The system running out of the block cache
+    std::unique_ptr<Core::GameBoy>& GetGameBoy()
+        { return cached; }
+
+private:
+    bool CompareCycles();
+    bool CompareRegisters();
+    bool CompareMemory();
+
+    std::unique_ptr<Core::GameBoy> cached;
+    std::unique_ptr<Core::GameBoy> interpreter;
+
+    u32 steps = 0;
+    bool diverged = false;
+};
+
+}; // namespace Debug
@@ -34,7 +34,7 @@ void Log(const std::string prefix, const std::string& msg)
 void LogRegisters(const Core::Processor& processor)
 {
     std::cout << "A: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.reg_A) << "h\n";
-    std::cout << "F: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.reg_F) << "h\n";
+    std::cout << "F: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.GetF()) << "h\n";
     std::cout << "B: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.reg_B) << "h\n";
     std::cout << "C: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.reg_C) << "h\n";
     std::cout << "D: " << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(processor.reg_D) << "h\n";
@@ -108,19 +108,19 @@ void LogDisassembly(std::shared_ptr<Memory::MemoryBus>& memory_bus, u16 address,
         {
             // 1 byte operand
             operand8 = memory_bus->Read8(address++);
-            printf(lookup_table[opcode].name.c_str(), operand8);
+            printf(lookup_table[opcode].name, operand8);
         }
         else if(lookup_table[opcode].length == (3 + operand_adder))
         {
             // 2 byte operand
             operand16 = memory_bus->Read16(address);
             address += 2;
-            printf(lookup_table[opcode].name.c_str(), operand16);
+            printf(lookup_table[opcode].name, operand16);
         }
         else
         {
             // no operand
-            printf("%s", lookup_table[opcode].name.c_str());
+            printf("%s", lookup_table[opcode].name);
         }
 
         std::cout << std::endl;
@@ -0,0 +1,45 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Tracer.h"
+#include "Logger.h"
+
+
+namespace Debug {
+
+Tracer::Tracer(const std::string& path)
+:
+    file (std::fopen(path.c_str(), "wb")),
+    buffer (BUFFER_RECORDS)
+{
+    if(file == nullptr)
+        LOG_ERROR("Couldn't open trace file " + path);
+}
+
+Tracer::~Tracer()
+{
+    Flush();
+    if(file != nullptr)
+        std::fclose(file);
+}
+
+void Tracer::Flush()
+{
+    if(file != nullptr && count > 0)
+        std::fwrite(buffer.data(), sizeof(TraceRecord), count, file);
+    written += count;
+    count = 0;
+}
+
+}; // namespace Debug
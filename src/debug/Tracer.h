@@ -0,0 +1,74 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "../common/Types.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace Debug {
+
+// One executed instruction, as written to the trace file
+struct TraceRecord
+{
+    // Cycle the instruction started on
+    u64 cycle;
+    u16 pc;
+    u16 sp;
+    u16 af;
+    u16 bc;
+    u16 de;
+    u16 hl;
+    u8 opcode;
+    u8 ime;
+    u8 reserved[2];
+};
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must stay packed");
+
+// Writes a binary record per instruction the traced
+// interpreter runs, buffered to keep file IO off the hot path
+class Tracer
+{
+public:
+    // Records kept in memory between writes
+    static const int BUFFER_RECORDS = 4096;
+
+    Tracer(const std::string& path);
+    ~Tracer();
+
+    void Record(const TraceRecord& record)
+    {
+        buffer[count++] = record;
+        if(count == BUFFER_RECORDS)
+            Flush();
+    }
+    void Flush();
+
+    bool IsOpen()
+        { return file != nullptr; }
+    u64 GetRecords()
+        { return written + count; }
+
+private:
+    std::FILE* file;
+    std::vector<TraceRecord> buffer;
+    int count = 0;
+    u64 written = 0;
+};
+
+}; // namespace Debug
@@ -0,0 +1,49 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <chrono>
+
+
+// A benchmark is a function that times things and Reports them
+namespace Bench {
+    typedef void (*Function)();
+
+    struct Registration
+    {
+        Registration(const char* name, Function function);
+    };
+
+    // Prints one result line, in nanoseconds per operation
+    void Report(const char* what, double ns_per_op);
+
+    // Nanoseconds per operation of run(), which does 'ops' of them
+    template<typename Run>
+    double Time(long ops, Run run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+    }
+
+    // Keeps the optimizer from throwing a result away
+    extern volatile unsigned sink;
+}; // namespace Bench
+
+#define BENCHMARK(name)                                             \
+    static void name();                                             \
+    static Bench::Registration name##_registration(#name, name);    \
+    static void name()
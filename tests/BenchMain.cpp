@@ -0,0 +1,62 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace Bench {
+
+struct Entry
+{
+    const char* name;
+    Function function;
+};
+
+static std::vector<Entry>& Entries()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+volatile unsigned sink = 0;
+
+Registration::Registration(const char* name, Function function)
+{
+    Entries().push_back({ name, function });
+}
+
+void Report(const char* what, double ns_per_op)
+{
+    std::printf("    %-44s %10.2f ns/op\n", what, ns_per_op);
+}
+
+}; // namespace Bench
+
+// Runs every benchmark, or only those whose names contain the argument
+int main(int argc, char* argv[])
+{
+    for(const Bench::Entry& entry : Bench::Entries())
+    {
+        if(argc > 1 && std::strstr(entry.name, argv[1]) == nullptr)
+            continue;
+
+        std::printf("%s\n", entry.name);
+        entry.function();
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+#include "System.h"
+
+#include "core/processor/Processor.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+static const long INSTRUCTIONS = 20000000;
+
+// A system running code from 0x0100 on the interpreter, the
+// block cache or the recompiler
+static std::unique_ptr<Core::GameBoy> MakeLoop(const std::vector<u8>& code, bool block_cache, bool jit = false)
+{
+    std::vector<u8> rom = System::MakeRom(0x00, 2);
+    std::copy(code.begin(), code.end(), rom.begin() + 0x0100);
+    Core::GameBoy::Options options;
+    options.block_cache = block_cache;
+    options.jit = jit;
+    options.idle_loop_skip = false;
+    return System::Make(rom, options);
+}
+
+// Nanoseconds per instruction of running code
+static double TimeLoop(const std::vector<u8>& code, bool block_cache)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = MakeLoop(code, block_cache);
+    Core::Processor& processor = *gameboy->GetProcessor();
+    return Bench::Time(INSTRUCTIONS, [&]() {
+        for(long i = 0; i < INSTRUCTIONS; i++)
+            Bench::sink += processor.Tick();
+    });
+}
+
+// Nanoseconds per machine cycle of running code through RunCycles,
+// with the scheduler, events and interrupts all in the loop
+static double TimeRun(const std::vector<u8>& code, bool block_cache, bool jit = false)
+{
+    static const int CYCLES = 80000000;
+    std::unique_ptr<Core::GameBoy> gameboy = MakeLoop(code, block_cache, jit);
+    return Bench::Time(CYCLES / 4, [&]() {
+        for(int run = 0; run < CYCLES; run += Core::GameBoy::FRAME_CYCLES)
+            Bench::sink += gameboy->RunCycles(Core::GameBoy::FRAME_CYCLES).cycles;
+    });
+}
+
+static void ReportLoop(const char* what, double ns)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%s (%.0f M/s)", what, 1000.0 / ns);
+    Bench::Report(line, ns);
+}
+
+// The switch dispatcher that the handler tables replaced (before
+// db8e6c2) ran this same mix at about 14 ns/instruction on the host
+BENCHMARK(InstructionMix)
+{
+    // Loads, ALU, stack, a conditional jump and a call
+    // with its return, looping back to 0x0104
+    const std::vector<u8> code = {
+        0x3E, 0x12,                 // LD A,0x12
+        0x06, 0x34,                 // LD B,0x34
+        0x80,                       // ADD A,B
+        0x0C,                       // INC C
+        0x57,                       // LD D,A
+        0xAB,                       // XOR E
+        0x21, 0x00, 0xC0,           // LD HL,0xC000
+        0x77,                       // LD (HL),A
+        0x5E,                       // LD E,(HL)
+        0x23,                       // INC HL
+        0xC5,                       // PUSH BC
+        0xC1,                       // POP BC
+        0x92,                       // SUB D
+        0x07,                       // RLCA
+        0xFE, 0x10,                 // CP 0x10
+        0x20, 0x00,                 // JR NZ,+0
+        0xCB, 0x37,                 // SWAP A
+        0xCD, 0x1E, 0x01,           // CALL 0x011E
+        0xC3, 0x04, 0x01,           // JP 0x0104
+        0xE6, 0x7F,                 // AND 0x7F
+        0xC9,                       // RET
+    };
+    ReportLoop("instruction, interpreter", TimeLoop(code, false));
+    ReportLoop("machine cycle, interpreter", TimeRun(code, false));
+    ReportLoop("machine cycle, block cache", TimeRun(code, true));
+    ReportLoop("machine cycle, recompiler", TimeRun(code, true, true));
+}
+
+BENCHMARK(ALUFlags)
+{
+    // The same ALU loop with the flags never read, then read
+    // by a JR NZ after each instruction in place of a JR
+    std::vector<u8> code = {
+        0x80, 0x18, 0x00,           // ADD A,B
+        0x91, 0x18, 0x00,           // SUB C
+        0xAA, 0x18, 0x00,           // XOR D
+        0x1C, 0x18, 0x00,           // INC E
+        0x25, 0x18, 0x00,           // DEC H
+        0xA5, 0x18, 0x00,           // AND L
+        0xB0, 0x18, 0x00,           // OR B
+        0xB9, 0x18, 0x00,           // CP C
+        0xC3, 0x00, 0x01,           // JP 0x0100
+    };
+    ReportLoop("ALU + JR, flags never read", TimeLoop(code, false));
+    for(size_t i = 1; i < code.size() - 3; i += 3)
+        code[i] = 0x20;
+    ReportLoop("ALU + JR NZ, flags read after each", TimeLoop(code, false));
+}
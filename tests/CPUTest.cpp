@@ -0,0 +1,230 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+#include "System.h"
+
+#include "core/processor/Processor.h"
+#include "core/memory/MemoryBus.h"
+#include "debug/Lockstep.h"
+
+#include <random>
+
+
+// The 8-bit ALU instructions with lazy flags, all on A and B
+static const u8 ALU_OPS[] = {
+    0x80, 0x88, 0x90, 0x98, 0xA0, 0xA8, 0xB0, 0xB8, 0x3C, 0x3D
+};
+
+// Result in a and flags of an ALU instruction, as the
+// eager flag helpers worked them out
+static u8 EagerALU(u8 opcode, u8& a, u8 b, u8 f)
+{
+    u8 carry = (f & 0x10)? 1 : 0;
+    u8 z;
+    switch(opcode)
+    {
+    case 0x88:  // ADC A,B
+    case 0x80:  // ADD A,B
+        carry = (opcode == 0x88)? carry : 0;
+        f = (((a & 0x0F) + (b & 0x0F) + carry) & 0x10)? 0x20 : 0x00;
+        f |= ((a + b + carry) & 0x0100)? 0x10 : 0x00;
+        a += b + carry;
+        return f | ((a == 0x00)? 0x80 : 0x00);
+    case 0x98:  // SBC A,B
+    case 0x90:  // SUB B
+    case 0xB8:  // CP B
+        carry = (opcode == 0x98)? carry : 0;
+        f = 0x40;
+        f |= ((a & 0x0F) < ((b & 0x0F) + carry))? 0x20 : 0x00;
+        f |= (a < (b + carry))? 0x10 : 0x00;
+        z = a - b - carry;
+        if(opcode != 0xB8)
+            a = z;
+        return f | ((z == 0x00)? 0x80 : 0x00);
+    case 0xA0:  // AND B
+        a &= b;
+        return 0x20 | ((a == 0x00)? 0x80 : 0x00);
+    case 0xA8:  // XOR B
+        a ^= b;
+        return (a == 0x00)? 0x80 : 0x00;
+    case 0xB0:  // OR B
+        a |= b;
+        return (a == 0x00)? 0x80 : 0x00;
+    case 0x3C:  // INC A
+        f = (f & 0x1F) | (((a & 0x0F) == 0x0F)? 0x20 : 0x00);
+        a++;
+        return f | ((a == 0x00)? 0x80 : 0x00);
+    case 0x3D:  // DEC A
+        f = (f & 0x1F) | 0x40 | (((a & 0x0F) == 0x00)? 0x20 : 0x00);
+        a--;
+        return f | ((a == 0x00)? 0x80 : 0x00);
+    }
+    return f;
+}
+
+// Runs one instruction out of WRAM with A and B set
+static void Run(Core::GameBoy& gameboy, u8 opcode, u8 a, u8 b)
+{
+    Core::Processor& processor = *gameboy.GetProcessor();
+    gameboy.GetMemoryBus()->Write8(0xC000, opcode);
+    Core::ProcessorState state = processor.GetState();
+    state.reg_PC.word = 0xC000;
+    state.reg_A = a;
+    state.reg_B = b;
+    processor.SetState(state);
+    processor.Tick();
+}
+
+TEST(LazyFlagsMatchEagerFlags)
+{
+    Core::GameBoy::Options options;
+    options.block_cache = false;
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2), options);
+    Core::Processor& processor = *gameboy->GetProcessor();
+    const Core::ProcessorState start = processor.GetState();
+
+    // Every operand pair, from settled flags
+    for(u8 opcode : ALU_OPS)
+    {
+        for(int operands = 0; operands < 0x20000; operands++)
+        {
+            u8 a = operands & 0xFF;
+            u8 b = (operands >> 8) & 0xFF;
+            u8 f = (operands & 0x10000)? 0xB0 : 0x40;
+            Core::ProcessorState state = start;
+            state.reg_F = f;
+            processor.SetState(state);
+            Run(*gameboy, opcode, a, b);
+
+            u8 expected = EagerALU(opcode, a, b, f);
+            CHECK(processor.GetState().reg_A == a);
+            CHECK(processor.GetF() == expected);
+        }
+    }
+
+    // Runs of them, each one left pending when the next starts
+    std::mt19937 random(1);
+    processor.SetState(start);
+    u8 a = start.reg_A;
+    u8 f = processor.GetF();
+    for(int i = 0; i < 1000000; i++)
+    {
+        u8 opcode = ALU_OPS[random() % sizeof(ALU_OPS)];
+        u8 b = random();
+        Run(*gameboy, opcode, a, b);
+
+        f = EagerALU(opcode, a, b, f);
+        CHECK(processor.GetState().reg_A == a);
+        CHECK(processor.GetF() == f);
+    }
+}
+
+// Random loads, stores, stack and ALU instructions that keep HL
+// and SP in WRAM, looped with the timer interrupt firing into them
+static std::vector<u8> MakeMixedRom(u32 seed)
+{
+    std::vector<u8> rom = System::MakeRom(0x00, 2);
+    const u8 entry[] = {
+        0xC3, 0x50, 0x01            // JP 0x0150, past the header
+    };
+    const u8 start[] = {
+        0x3E, 0x04, 0xE0, 0xFF,     // LD A,0x04; LDH (IE),A
+        0x3E, 0x05, 0xE0, 0x07,     // LD A,0x05; LDH (TAC),A
+        0xFB,                       // EI
+    };
+    const u8 timer[] = {
+        0x34, 0xD9                  // INC (HL); RETI
+    };
+    std::copy(timer, timer + sizeof(timer), rom.begin() + 0x0050);
+    std::copy(entry, entry + sizeof(entry), rom.begin() + 0x0100);
+    std::copy(start, start + sizeof(start), rom.begin() + 0x0150);
+
+    u16 loop = 0x0150 + sizeof(start);
+    u16 pc = loop;
+    auto emit = [&](u8 byte) { rom[pc++] = byte; };
+    emit(0x31); emit(0x00); emit(0xD8);             // LD SP,0xD800
+    emit(0x21); emit(0x00); emit(0xC8);             // LD HL,0xC800
+
+    std::mt19937 random(seed);
+    for(int i = 0; i < 400; i++)
+    {
+        // A conditional jump now and then to end the block
+        if(i % 32 == 31)
+        {
+            emit(0x20); emit(0x00);                 // JR NZ,+0
+            continue;
+        }
+        u8 r = random() % 8;
+        switch(random() % 12)
+        {
+        case 0:
+        case 1:
+            // LD r,r' and LD r,(HL) into anything but H and L
+            emit(0x40 | ((r % 4 == 3? 7 : r % 4) << 3) | (random() % 8));
+            break;
+        case 2:
+        case 3:
+        case 4:
+            emit(0x80 | (random() % 0x40));         // ALU A,r and ALU A,(HL)
+            break;
+        case 5:
+            emit(0xC6 | (r << 3));                  // ALU A,n
+            emit(random());
+            break;
+        case 6:
+            // INC r and DEC r on B, C, D, E and A
+            emit(((r > 3? 7 : r) << 3) | 0x04 | (random() % 2));
+            break;
+        case 7:
+            emit(0x70 | (r == 6? 7 : r));           // LD (HL),r
+            break;
+        case 8:
+            emit(random() % 2? 0x22 : 0x3A);        // LD (HL+),A and LD A,(HL-)
+            break;
+        case 9:
+            emit(0xC5 | ((r % 3) << 4));            // PUSH BC, DE or HL
+            break;
+        case 10:
+            emit(0xC1 | ((r % 2) << 4));            // POP BC or DE
+            break;
+        default:
+            emit(0x07 | ((r % 4) << 3));            // RLCA, RRCA, RLA and RRA
+            break;
+        }
+    }
+    emit(0xC3); emit(loop & 0xFF); emit(loop >> 8); // JP loop
+    return rom;
+}
+
+TEST(RecompiledCodeMatchesInterpreter)
+{
+    for(u32 seed = 1; seed <= 4; seed++)
+    {
+        Core::GameBoy::Options options;
+        options.skip_bootrom = true;
+        options.idle_loop_skip = false;
+        options.jit = true;
+        std::unique_ptr<Core::RomImage> rom (new Core::RomImage(MakeMixedRom(seed)));
+        Debug::Lockstep lockstep(options, 160, 144, std::move(rom), std::vector<u8>(0x100));
+        for(int step = 0; step < 20000; step++)
+            CHECK(lockstep.Step());
+
+#if defined(__x86_64__)
+        Core::Recompiler::Stats& stats = lockstep.GetGameBoy()->GetProcessor()->GetRecompiler().GetStats();
+        CHECK(stats.blocks > 0);
+        CHECK(stats.inline_instructions > 0);
+#endif
+    }
+}
@@ -0,0 +1,112 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+
+#include "core/PPU.h"
+#include "common/Globals.h"
+
+#include <random>
+#include <vector>
+
+
+static u16 MortonRow(u8 low, u8 high)
+{
+    u32 morton = (static_cast<u32>(high) << 16) | low;
+    morton = (morton ^ (morton << 4)) & 0x0F0F0F0F;
+    morton = (morton ^ (morton << 2)) & 0x33333333;
+    morton = (morton ^ (morton << 1)) & 0x55555555;
+    return static_cast<u16>(morton | (morton >> 15));
+}
+
+BENCHMARK(TileRowKernels)
+{
+    const int TILES = 4096;
+    const int PASSES = 64;
+    std::mt19937 random(20);
+    std::vector<u8> vram(TILES * 16);
+    for(u8& byte : vram)
+        byte = random();
+    std::vector<Graphics::Tile> tiles(TILES);
+
+    double morton = Bench::Time(TILES * 8L * PASSES, [&]() {
+        for(int pass = 0; pass < PASSES; pass++)
+        {
+            for(int tile = 0; tile < TILES; tile++)
+            {
+                const u8* src = &vram[tile * 16];
+                for(int row = 0; row < 8; row++)
+                    tiles[tile].rows[row] = MortonRow(src[row*2], src[(row*2)+1]);
+            }
+            Bench::sink += tiles[pass].rows[0];
+        }
+    });
+    double table = Bench::Time(TILES * 8L * PASSES, [&]() {
+        for(int pass = 0; pass < PASSES; pass++)
+        {
+            for(int tile = 0; tile < TILES; tile++)
+                tiles[tile].DecodeTable(&vram[tile * 16]);
+            Bench::sink += tiles[pass].rows[0];
+        }
+    });
+    double decode = Bench::Time(TILES * 8L * PASSES, [&]() {
+        for(int pass = 0; pass < PASSES; pass++)
+        {
+            for(int tile = 0; tile < TILES; tile++)
+                tiles[tile].Decode(&vram[tile * 16]);
+            Bench::sink += tiles[pass].rows[0];
+        }
+    });
+    Bench::Report("decode a row, Morton shifts", morton);
+    Bench::Report("decode a row, Tile::DecodeTable", table);
+    Bench::Report("decode a row, Tile::Decode", decode);
+
+    Color palette[4] = { gColors[0], gColors[1], gColors[2], gColors[3] };
+    Color halves[256][4];
+    for(int bits = 0; bits < 256; bits++)
+    {
+        for(int px = 0; px < 4; px++)
+            halves[bits][px] = palette[(bits >> (6 - (px * 2))) & 0x03];
+    }
+    std::vector<Color> out(TILES * 8 * 8);
+    double per_pixel = Bench::Time(TILES * 8L * PASSES, [&]() {
+        for(int pass = 0; pass < PASSES; pass++)
+        {
+            Color* line = out.data();
+            for(Graphics::Tile& tile : tiles)
+            {
+                for(int row = 0; row < 8; row++)
+                {
+                    for(int x = 0; x < 8; x++)
+                        *line++ = palette[tile.GetPixel(x, row)];
+                }
+            }
+            Bench::sink += out[pass];
+        }
+    });
+    double expanded = Bench::Time(TILES * 8L * PASSES, [&]() {
+        for(int pass = 0; pass < PASSES; pass++)
+        {
+            Color* line = out.data();
+            for(Graphics::Tile& tile : tiles)
+            {
+                for(int row = 0; row < 8; row++, line += 8)
+                    Graphics::ExpandRow(tile.rows[row], halves, line);
+            }
+            Bench::sink += out[pass];
+        }
+    });
+    Bench::Report("color a row, GetPixel per pixel", per_pixel);
+    Bench::Report("color a row, ExpandRow", expanded);
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+
+#include "core/PPU.h"
+#include "common/Globals.h"
+
+
+// Tile::Decode as it was before BIT_SPREAD, spreading the
+// bitplanes apart with Morton shifts
+static u16 MortonRow(u8 low, u8 high)
+{
+    u32 morton = (static_cast<u32>(high) << 16) | low;
+    morton = (morton ^ (morton << 4)) & 0x0F0F0F0F;
+    morton = (morton ^ (morton << 2)) & 0x33333333;
+    morton = (morton ^ (morton << 1)) & 0x55555555;
+    return static_cast<u16>(morton | (morton >> 15));
+}
+
+// Color of pixel x, counted from the left, straight from the bitplanes
+static u8 BitplanePixel(u8 low, u8 high, int x)
+{
+    int bit = 7 - x;
+    return static_cast<u8>((((high >> bit) & 1) << 1) | ((low >> bit) & 1));
+}
+
+TEST(TileDecodeMatchesScalarDecode)
+{
+    for(int input = 0; input < 0x10000; input++)
+    {
+        u8 low = input & 0xFF;
+        u8 high = input >> 8;
+        // Every row of the tile gets a different input
+        u8 src[16];
+        for(int row = 0; row < 8; row++)
+        {
+            src[row*2] = low + row;
+            src[(row*2)+1] = high ^ row;
+        }
+        Graphics::Tile tile;
+        tile.Decode(src);
+        Graphics::Tile table;
+        table.DecodeTable(src);
+
+        for(int row = 0; row < 8; row++)
+        {
+            CHECK(tile.rows[row] == MortonRow(src[row*2], src[(row*2)+1]));
+            CHECK(table.rows[row] == tile.rows[row]);
+            for(int x = 0; x < 8; x++)
+                CHECK(tile.GetPixel(x, row) == BitplanePixel(src[row*2], src[(row*2)+1], x));
+        }
+    }
+}
+
+TEST(ExpandRowMatchesGetPixel)
+{
+    // Every palette, and every decoded row, since decoding is one to one
+    for(int palette = 0; palette < 256; palette++)
+    {
+        Color colors[4];
+        for(int i = 0; i < 4; i++)
+            colors[i] = gColors[(palette >> (i * 2)) & 0x03];
+        Color halves[256][4];
+        for(int bits = 0; bits < 256; bits++)
+        {
+            for(int px = 0; px < 4; px++)
+                halves[bits][px] = colors[(bits >> (6 - (px * 2))) & 0x03];
+        }
+
+        Graphics::Tile tile;
+        for(int row = 0; row < 0x10000; row++)
+        {
+            tile.rows[0] = row;
+            Color out[8];
+            Graphics::ExpandRow(tile.rows[0], halves, out);
+            for(int x = 0; x < 8; x++)
+                CHECK(out[x] == colors[tile.GetPixel(x, 0)]);
+        }
+    }
+}
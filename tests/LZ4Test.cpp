@@ -0,0 +1,118 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+
+#include "core/LZ4.h"
+
+#include <algorithm>
+#include <random>
+
+
+// Compresses and decompresses bytes, which must come back unchanged
+static bool RoundTrips(const std::vector<u8>& bytes)
+{
+    std::vector<u8> packed = Core::LZ4::Compress(bytes.data(), bytes.size());
+    std::vector<u8> unpacked(bytes.size() + 1, 0xEE);
+    if(!Core::LZ4::Decompress(packed.data(), packed.size(), unpacked.data(), bytes.size()))
+        return false;
+    // Nothing written past the end
+    return unpacked.back() == 0xEE &&
+           std::equal(bytes.begin(), bytes.end(), unpacked.begin());
+}
+
+static std::vector<u8> RandomBytes(u32 size, u32 seed)
+{
+    std::mt19937 random(seed);
+    std::vector<u8> bytes(size);
+    for(u8& byte : bytes)
+        byte = random();
+    return bytes;
+}
+
+TEST(LZ4RoundTrips)
+{
+    const u32 BANK_SIZE = 0x4000;
+
+    CHECK(RoundTrips(std::vector<u8>()));
+    for(u32 size = 1; size < 12; size++)
+    {
+        CHECK(RoundTrips(RandomBytes(size, size)));
+        CHECK(RoundTrips(std::vector<u8>(size, 0x00)));
+    }
+    // Highly compressible: a blank bank and a repeating pattern
+    std::vector<u8> blank(BANK_SIZE, 0x00);
+    CHECK(RoundTrips(blank));
+    CHECK(Core::LZ4::Compress(blank.data(), blank.size()).size() < 128);
+    std::vector<u8> pattern(BANK_SIZE);
+    for(u32 i = 0; i < BANK_SIZE; i++)
+        pattern[i] = (i % 7) * 3;
+    CHECK(RoundTrips(pattern));
+    // Incompressible random banks, and random ones with runs in them
+    for(u32 seed = 1; seed <= 16; seed++)
+    {
+        std::vector<u8> bank = RandomBytes(BANK_SIZE, seed);
+        CHECK(RoundTrips(bank));
+        for(u32 i = 0; i < BANK_SIZE; i += 64 + (bank[i] % 64))
+            std::fill(bank.begin() + i, bank.begin() + std::min(i + (bank[i] % 48), BANK_SIZE), bank[i]);
+        CHECK(RoundTrips(bank));
+    }
+}
+
+TEST(LZ4RejectsTruncatedInput)
+{
+    std::vector<u8> bytes = RandomBytes(0x1000, 1);
+    for(u32 i = 0; i < bytes.size(); i += 16)
+        std::fill(bytes.begin() + i, bytes.begin() + i + 8, 0x00);
+    std::vector<u8> packed = Core::LZ4::Compress(bytes.data(), bytes.size());
+    std::vector<u8> out(bytes.size());
+
+    CHECK(Core::LZ4::Decompress(packed.data(), packed.size(), out.data(), out.size()));
+    for(u32 size = 0; size < packed.size(); size++)
+        CHECK(!Core::LZ4::Decompress(packed.data(), size, out.data(), out.size()));
+}
+
+TEST(LZ4RejectsBadOffsets)
+{
+    u8 out[16];
+    // One literal, then a match 2 back
+    const u8 before_start[] = { 0x10, 'a', 0x02, 0x00 };
+    CHECK(!Core::LZ4::Decompress(before_start, sizeof(before_start), out, 5));
+    // A zero offset
+    const u8 zero[] = { 0x10, 'a', 0x00, 0x00 };
+    CHECK(!Core::LZ4::Decompress(zero, sizeof(zero), out, 5));
+    // One back is fine
+    const u8 good[] = { 0x10, 'a', 0x01, 0x00, 0x10, 'b' };
+    CHECK(Core::LZ4::Decompress(good, sizeof(good), out, 6));
+    CHECK(out[4] == 'a' && out[5] == 'b');
+}
+
+TEST(LZ4RejectsOverruns)
+{
+    u8 out[16];
+    std::fill(out, out + 16, 0xEE);
+    // Four literals into two bytes
+    const u8 literals[] = { 0x40, 'a', 'b', 'c', 'd' };
+    CHECK(!Core::LZ4::Decompress(literals, sizeof(literals), out, 2));
+    CHECK(out[2] == 0xEE);
+    // A 5-byte match into 3 bytes
+    const u8 match[] = { 0x11, 'a', 0x01, 0x00, 0x00 };
+    CHECK(!Core::LZ4::Decompress(match, sizeof(match), out, 3));
+    CHECK(out[3] == 0xEE);
+    // A long literal length running past the end of the input
+    const u8 length[] = { 0xF0, 0xFF, 0xFF };
+    CHECK(!Core::LZ4::Decompress(length, sizeof(length), out, 16));
+    // Decoding short of the end fails too
+    CHECK(!Core::LZ4::Decompress(literals, sizeof(literals), out, 8));
+}
@@ -0,0 +1,118 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+#include "System.h"
+
+#include "core/memory/MemoryBus.h"
+
+#include <cstdio>
+#include <random>
+
+
+static const long ACCESSES = 20000000;
+
+// Addresses spread over [first, last]
+static std::vector<u16> Addresses(u16 first, u16 last)
+{
+    std::mt19937 random(1);
+    std::vector<u16> addresses(4096);
+    for(u16& address : addresses)
+        address = first + (random() % (last - first + 1));
+    return addresses;
+}
+
+static void TimeRegion(Memory::MemoryBus& bus, const char* name, const std::vector<u16>& addresses, bool write)
+{
+    char what[64];
+    snprintf(what, sizeof(what), "%s %s", (write)? "Write8" : "Read8", name);
+    size_t mask = addresses.size() - 1;
+    double ns;
+    if(write)
+    {
+        ns = Bench::Time(ACCESSES, [&]() {
+            for(long i = 0; i < ACCESSES; i++)
+                bus.Write8(addresses[i & mask], i);
+        });
+    }
+    else
+    {
+        ns = Bench::Time(ACCESSES, [&]() {
+            unsigned sum = 0;
+            for(long i = 0; i < ACCESSES; i++)
+                sum += bus.Read8(addresses[i & mask]);
+            Bench::sink += sum;
+        });
+    }
+    Bench::Report(what, ns);
+}
+
+BENCHMARK(MemoryBusAccess)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    // IO is the joypad, timer and scroll registers
+    const u16 registers[] = { 0xFF00, 0xFF05, 0xFF06, 0xFF42, 0xFF43 };
+    std::vector<u16> io(4096);
+    for(size_t i = 0; i < io.size(); i++)
+        io[i] = registers[i % 5];
+    // Mostly ROM and WRAM, like the code that runs
+    std::vector<u16> rom = Addresses(0x0000, 0x7FFF);
+    std::vector<u16> wram = Addresses(0xC000, 0xDFFF);
+    std::vector<u16> hram = Addresses(0xFF80, 0xFFFE);
+    std::vector<u16> mix(4096);
+    for(size_t i = 0; i < mix.size(); i++)
+    {
+        const std::vector<u16>& from = (i % 8 < 4)? rom : (i % 8 < 6)? wram : (i % 8 < 7)? hram : io;
+        mix[i] = from[i];
+    }
+
+    TimeRegion(bus, "ROM", rom, false);
+    TimeRegion(bus, "WRAM", wram, false);
+    TimeRegion(bus, "HRAM", hram, false);
+    TimeRegion(bus, "IO", io, false);
+    TimeRegion(bus, "mix", mix, false);
+    TimeRegion(bus, "WRAM", wram, true);
+    TimeRegion(bus, "HRAM", hram, true);
+    TimeRegion(bus, "IO", io, true);
+}
+
+BENCHMARK(CartridgeAccess)
+{
+    const struct { const char* name; u8 cart_type; int banks; } carts[] = {
+        { "ROM only", 0x00, 2 },
+        { "MBC1", 0x01, 64 },
+        { "MBC3", 0x13, 64 },
+    };
+    std::vector<u16> rom = Addresses(0x0000, 0x7FFF);
+    std::vector<u16> bank_select = Addresses(0x2000, 0x3FFF);
+    std::vector<u16> sram = Addresses(0xA000, 0xBFFF);
+    for(auto& cart : carts)
+    {
+        std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(cart.cart_type, cart.banks));
+        Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+        // RAM enable
+        bus.Write8(0x0000, 0x0A);
+
+        char name[32];
+        snprintf(name, sizeof(name), "ROM, %s", cart.name);
+        TimeRegion(bus, name, rom, false);
+        snprintf(name, sizeof(name), "bank select, %s", cart.name);
+        TimeRegion(bus, name, bank_select, true);
+        snprintf(name, sizeof(name), "SRAM, %s", cart.name);
+        TimeRegion(bus, name, sram, false);
+        TimeRegion(bus, name, sram, true);
+    }
+}
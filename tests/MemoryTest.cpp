@@ -0,0 +1,186 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+#include "System.h"
+
+#include "core/RomImage.h"
+#include "core/memory/MemoryBus.h"
+
+
+TEST(IORegisterMasks)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    // P1: only the select bits are written, the top two read as 1
+    bus.Write8(0xFF00, 0x10);
+    CHECK(bus.Read8(0xFF00) == 0xDF);
+    bus.Write8(0xFF00, 0xFF);
+    CHECK(bus.Read8(0xFF00) == 0xFF);
+    // SC: only the start and clock bits read back
+    bus.Write8(0xFF02, 0x00);
+    CHECK(bus.Read8(0xFF02) == 0x7E);
+    bus.Write8(0xFF02, 0xFF);
+    CHECK(bus.Read8(0xFF02) == 0xFF);
+    // TAC: three bits
+    bus.Write8(0xFF07, 0x00);
+    CHECK(bus.Read8(0xFF07) == 0xF8);
+    // STAT: the mode and coincidence bits can't be written
+    u8 mode = bus.Read8(0xFF41) & 0x07;
+    bus.Write8(0xFF41, 0xFF);
+    CHECK(bus.Read8(0xFF41) == (0x78 | mode));
+    bus.Write8(0xFF41, 0x00);
+    CHECK(bus.Read8(0xFF41) == mode);
+    // IF and IE are plain
+    bus.Write8(0xFF0F, 0xFF);
+    CHECK(bus.Read8(0xFF0F) == 0xFF);
+    bus.Write8(0xFFFF, 0x15);
+    CHECK(bus.Read8(0xFFFF) == 0x15);
+}
+
+TEST(UnmappedIOReadsOpenBus)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    const u16 unmapped[] = { 0xFF03, 0xFF08, 0xFF4C, 0xFF7F };
+    for(u16 address : unmapped)
+    {
+        bus.Write8(address, 0x00);
+        CHECK(bus.Read8(address) == 0xFF);
+    }
+}
+
+TEST(IORegisterCounters)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    const Memory::IORegister& scx = bus.GetIORegister(0xFF43);
+    u32 reads = scx.reads;
+    u32 writes = scx.writes;
+    for(int i = 0; i < 5; i++)
+        bus.Write8(0xFF43, i);
+    for(int i = 0; i < 3; i++)
+        bus.Read8(0xFF43);
+    CHECK(scx.writes == writes + 5);
+    CHECK(scx.reads == reads + 3);
+    // HRAM shares the page but isn't a register
+    bus.Write8(0xFF80, 0x12);
+    CHECK(bus.Read8(0xFF80) == 0x12);
+    CHECK(scx.writes == writes + 5);
+}
+
+// A cartridge with every bank's number at its start and end
+static std::unique_ptr<Core::GameBoy> MakeStamped(u8 cart_type, int banks)
+{
+    std::vector<u8> rom = System::MakeRom(cart_type, banks);
+    for(int bank = 1; bank < banks; bank++)
+    {
+        rom[bank * Core::RomImage::BANK_SIZE] = bank;
+        rom[((bank + 1) * Core::RomImage::BANK_SIZE) - 1] = bank;
+    }
+    return System::Make(rom);
+}
+
+static bool BankMapped(Memory::MemoryBus& bus, int bank)
+{
+    return bus.Read8(0x4000) == bank && bus.Read8(0x7FFF) == bank;
+}
+
+TEST(MBC1BanksWrap)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = MakeStamped(0x01, 8);
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    CHECK(BankMapped(bus, 1));
+    for(int bank = 1; bank < 8; bank++)
+    {
+        bus.Write8(0x2000, bank);
+        CHECK(BankMapped(bus, bank));
+    }
+    // Bank 0 selects 1, and banks past the end wrap around
+    bus.Write8(0x2000, 0x00);
+    CHECK(BankMapped(bus, 1));
+    bus.Write8(0x2000, 0x0B);
+    CHECK(BankMapped(bus, 0x0B % 8));
+    // So do the upper bits from 0x4000
+    bus.Write8(0x2000, 0x02);
+    bus.Write8(0x4000, 0x01);
+    CHECK(BankMapped(bus, 0x22 % 8));
+}
+
+TEST(MBC3BanksWrap)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = MakeStamped(0x13, 8);
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    for(int bank = 1; bank < 8; bank++)
+    {
+        bus.Write8(0x2000, bank);
+        CHECK(BankMapped(bus, bank));
+    }
+    bus.Write8(0x2000, 0x80);
+    CHECK(BankMapped(bus, 1));
+    bus.Write8(0x2000, 0x45);
+    CHECK(BankMapped(bus, 0x45 % 8));
+}
+
+TEST(MBC1RAMEnableRemaps)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = MakeStamped(0x01, 8);
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    // RAM banking mode with bank 2 selected; while RAM
+    // is disabled 0xA000 stays on bank 0
+    bus.Write8(0x6000, 0x01);
+    bus.Write8(0x4000, 0x02);
+    bus.Write8(0xA000, 0xAB);
+    bus.Write8(0x0000, 0x0A);
+    CHECK(bus.Read8(0xA000) == 0x00);
+    bus.Write8(0xA000, 0xCD);
+    CHECK(bus.Read8(0xBFFF) == 0x00);
+    bus.Write8(0x0000, 0x00);
+    CHECK(bus.Read8(0xA000) == 0xAB);
+    bus.Write8(0x0000, 0x0A);
+    CHECK(bus.Read8(0xA000) == 0xCD);
+}
+
+TEST(MBC3RAMBanksRemap)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = MakeStamped(0x13, 8);
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+
+    // Writes still go through MBC1's banking mode, so turn it on
+    bus.Write8(0x0000, 0x0A);
+    bus.Write8(0x6000, 0x01);
+    for(int bank = 0; bank < 4; bank++)
+    {
+        bus.Write8(0x4000, bank);
+        bus.Write8(0xA000, 0x10 + bank);
+        bus.Write8(0xBFFF, 0x20 + bank);
+    }
+    for(int bank = 0; bank < 4; bank++)
+    {
+        bus.Write8(0x4000, bank);
+        CHECK(bus.Read8(0xA000) == 0x10 + bank);
+        CHECK(bus.Read8(0xBFFF) == 0x20 + bank);
+    }
+    // The RTC registers have no RAM behind them
+    bus.Write8(0x4000, 0x08);
+    CHECK(bus.Read8(0xA000) == 0xFF);
+    bus.Write8(0x4000, 0x01);
+    CHECK(bus.Read8(0xA000) == 0x11);
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+#include "Reference.h"
+#include "System.h"
+
+#include "core/PPU.h"
+#include "core/memory/MemoryBus.h"
+
+#include <random>
+
+
+static const u32 FRAMES = 200;
+
+// Nanoseconds per visible line of running the PPU through FRAMES
+// frames of random VRAM; write_vram rewrites a map entry every line
+static double TimeLines(bool write_vram)
+{
+    Core::GameBoy::Options options;
+    options.line_skip = false;
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2), options);
+    Core::PPU& ppu = *gameboy->GetPPU();
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+    std::mt19937 random(1);
+    for(int address = 0x8000; address < 0xA000; address++)
+        bus.Write8(address, random());
+    bus.Write8(0xFF40, 0x91);
+    bus.Write8(0xFF47, 0xE4);
+
+    return Bench::Time(FRAMES * 144L, [&]() {
+        while(ppu.GetFrameCount() < FRAMES)
+        {
+            if(write_vram && (bus.Read8(0xFF41) & 0x03) == DISPLAY_HBLANK)
+                bus.Write8(0x9800 + (random() % 0x400), random());
+            System::StepPPU(*gameboy);
+        }
+    });
+}
+
+BENCHMARK(BackgroundScanline)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+    std::mt19937 random(1);
+    for(int address = 0x8000; address < 0xA000; address++)
+        bus.Write8(address, random());
+    bus.Write8(0xFF40, 0x91);
+    Color line[160];
+    double reference = Bench::Time(FRAMES * 144L, [&]() {
+        for(u32 i = 0; i < FRAMES * 144; i++)
+        {
+            Reference::DrawBackground(bus, line);
+            Bench::sink += line[i % 160];
+        }
+    });
+
+    Bench::Report("BG line, per pixel reference", reference);
+    Bench::Report("BG line, PPU, static VRAM", TimeLines(false));
+    Bench::Report("BG line, PPU, map written every line", TimeLines(true));
+}
@@ -0,0 +1,202 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+#include "Reference.h"
+#include "System.h"
+
+#include "core/PPU.h"
+#include "core/memory/MemoryBus.h"
+
+#include <random>
+
+
+// Changes one of the things the PPU draws from at random
+static void Mutate(Memory::MemoryBus& bus, std::mt19937& random, u8 lcdc)
+{
+    switch(random() % 8)
+    {
+    case 0: bus.Write8(0xFF42 + (random() % 2), random()); break;      // SCY, SCX
+    case 1: bus.Write8(0xFF47 + (random() % 3), random()); break;      // BGP, OBP0, OBP1
+    case 2: bus.Write8(0xFF4A, random() % 150); break;                 // WY
+    case 3: bus.Write8(0xFF4B, random() % 170); break;                 // WX
+    case 4: bus.Write8(0xFF40, (random() & 0x7D) | lcdc); break;
+    case 5:
+        // A few bytes of a tile or a map
+        {
+            u16 address = 0x8000 + (random() % 0x2000);
+            for(int i = 0; i < 4; i++)
+                bus.Write8((address + i) & 0x9FFF, random());
+        }
+        break;
+    case 6:
+        // A sprite, mostly on screen
+        {
+            u16 address = 0xFE00 + ((random() % 40) * 4);
+            bus.Write8(address, random() % 176);
+            bus.Write8(address + 1, random() % 176);
+            bus.Write8(address + 2, random());
+            bus.Write8(address + 3, random());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Runs frames of random VRAM and registers, changing some of them
+// between lines, and checks every line the PPU draws against the
+// reference; lcdc holds the LCDC bits that are always set
+static void CheckFrames(u32 seed, u8 lcdc, u32 frames)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2));
+    Core::PPU& ppu = *gameboy->GetPPU();
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+    std::mt19937 random(seed);
+    for(int address = 0x8000; address < 0xA000; address++)
+        bus.Write8(address, random());
+    for(int i = 0; i < 64; i++)
+        Mutate(bus, random, lcdc);
+
+    while(ppu.GetFrameCount() < frames)
+    {
+        int mode = bus.Read8(0xFF41) & 0x03;
+        if(mode != DISPLAY_UPDATE)
+        {
+            if(random() % 4 == 0)
+                Mutate(bus, random, lcdc);
+            System::StepPPU(*gameboy);
+            continue;
+        }
+
+        // The line is drawn at the end of this mode
+        int ly = bus.Read8(0xFF44);
+        std::vector<Color>& back_buffer = ppu.GetBackBuffer();
+        Color background[160];
+        Color line[160];
+        Reference::DrawBackground(bus, background);
+        std::copy(&back_buffer[ly * 160], &back_buffer[(ly + 1) * 160], line);
+        Reference::DrawWindow(bus, line);
+        Reference::DrawSprites(bus, line);
+
+        System::StepPPU(*gameboy);
+        for(int x = 0; x < 160; x++)
+        {
+            CHECK(System::ScreenPixel(ly, x) == background[x]);
+            CHECK(back_buffer[(ly * 160) + x] == line[x]);
+        }
+    }
+}
+
+TEST(BackgroundLinesMatchReference)
+{
+    // Sprites off
+    for(u32 seed = 1; seed <= 8; seed++)
+        CheckFrames(seed, 0x80, 30);
+}
+
+TEST(SpriteLinesMatchReference)
+{
+    // Sprites on; LCDC changes between lines pick 8x8 or 8x16
+    for(u32 seed = 1; seed <= 8; seed++)
+        CheckFrames(seed, 0x82, 30);
+}
+
+// Everything the PPU drew in a frame: the screen, then the back buffer
+typedef std::vector<Color> Frame;
+
+// Runs frames of random VRAM and registers under options, changing
+// something on about one in 'rate' PPU steps, and records each frame
+// as it stands when V-Blank starts
+static std::vector<Frame> RecordFrames(u32 seed, Core::GameBoy::Options options, int rate, u32 frames,
+                                       Core::PPU::Stats& stats)
+{
+    std::unique_ptr<Core::GameBoy> gameboy = System::Make(System::MakeRom(0x00, 2), options);
+    Core::PPU& ppu = *gameboy->GetPPU();
+    Memory::MemoryBus& bus = *gameboy->GetMemoryBus();
+    std::mt19937 random(seed);
+    for(int address = 0x8000; address < 0xA000; address++)
+        bus.Write8(address, random());
+    for(int i = 0; i < 64; i++)
+        Mutate(bus, random, 0x82);
+
+    std::vector<Frame> recorded;
+    while(ppu.GetFrameCount() < frames)
+    {
+        if(random() % rate == 0)
+            Mutate(bus, random, 0x82);
+        u32 frame = ppu.GetFrameCount();
+        System::StepPPU(*gameboy);
+        if(ppu.GetFrameCount() == frame)
+            continue;
+
+        Frame drawn;
+        for(int ly = 0; ly < 144; ly++)
+        {
+            for(int x = 0; x < 160; x++)
+                drawn.push_back(System::ScreenPixel(ly, x));
+        }
+        std::vector<Color>& back_buffer = ppu.GetBackBuffer();
+        drawn.insert(drawn.end(), back_buffer.begin(), back_buffer.end());
+        recorded.push_back(drawn);
+    }
+    stats = ppu.GetStats();
+    return recorded;
+}
+
+TEST(DeferredFramesMatchScanlineFrames)
+{
+    for(int line_skip = 0; line_skip < 2; line_skip++)
+    {
+        for(u32 seed = 1; seed <= 12; seed++)
+        {
+            Core::GameBoy::Options options;
+            options.line_skip = line_skip;
+            Core::PPU::Stats stats;
+            std::vector<Frame> scanline = RecordFrames(seed, options, 4, 20, stats);
+            options.deferred_render = true;
+            std::vector<Frame> deferred = RecordFrames(seed, options, 4, 20, stats);
+            CHECK(stats.deferred_batches > 0);
+            CHECK(deferred.size() == scanline.size());
+            for(size_t frame = 0; frame < scanline.size(); frame++)
+                CHECK(deferred[frame] == scanline[frame]);
+        }
+    }
+}
+
+TEST(SkippedLinesMatchDrawnLines)
+{
+    // From a change every few steps to one every few frames
+    const int rates[] = { 20, 200, 2000 };
+    u64 lines_skipped = 0;
+    for(int rate : rates)
+    {
+        for(u32 seed = 1; seed <= 8; seed++)
+        {
+            Core::GameBoy::Options options;
+            options.line_skip = false;
+            Core::PPU::Stats stats;
+            std::vector<Frame> drawn = RecordFrames(seed, options, rate, 20, stats);
+            options.line_skip = true;
+            options.verify_line_skip = true;
+            std::vector<Frame> skipped = RecordFrames(seed, options, rate, 20, stats);
+            lines_skipped += stats.lines_skipped;
+            CHECK(stats.skip_mismatches == 0);
+            CHECK(skipped.size() == drawn.size());
+            for(size_t frame = 0; frame < drawn.size(); frame++)
+                CHECK(skipped[frame] == drawn[frame]);
+        }
+    }
+    CHECK(lines_skipped > 0);
+}
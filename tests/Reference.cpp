@@ -0,0 +1,115 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Reference.h"
+
+#include "core/memory/MemoryBus.h"
+#include "common/Globals.h"
+
+
+namespace Reference {
+
+static const int WIDTH = 160;
+
+// Color of pixel (x, y) of a BG tile, through BGP
+static Color BGPixel(Memory::MemoryBus& bus, u8 id, int x, int y)
+{
+    u8 LCDC = bus.Read8(0xFF40);
+    u16 address = (LCDC & 0x10)? 0x8000 + (id * 16) : 0x9000 + (static_cast<s8>(id) * 16);
+    u8 low = bus.Read8(address + (y * 2));
+    u8 high = bus.Read8(address + (y * 2) + 1);
+    int bit = 7 - x;
+    int color = (((high >> bit) & 1) << 1) | ((low >> bit) & 1);
+    return gColors[(bus.Read8(0xFF47) >> (color * 2)) & 0x03];
+}
+
+void DrawBackground(Memory::MemoryBus& bus, Color* line)
+{
+    u8 LCDC = bus.Read8(0xFF40);
+    u16 map = (LCDC & 0x08)? 0x9C00 : 0x9800;
+    u8 y = bus.Read8(0xFF44) + bus.Read8(0xFF42);
+    for(int screenX = 0; screenX < WIDTH; screenX++)
+    {
+        u8 x = screenX + bus.Read8(0xFF43);
+        u8 id = bus.Read8(map + ((y / 8) * 32) + (x / 8));
+        line[screenX] = BGPixel(bus, id, x % 8, y % 8);
+    }
+}
+
+void DrawWindow(Memory::MemoryBus& bus, Color* line)
+{
+    u8 LCDC = bus.Read8(0xFF40);
+    u8 LY = bus.Read8(0xFF44);
+    u8 WY = bus.Read8(0xFF4A);
+    u8 WX = bus.Read8(0xFF4B);
+    if(!(LCDC & 0x20) || LY < WY)
+        return;
+
+    u16 map = (LCDC & 0x40)? 0x9C00 : 0x9800;
+    u8 y = LY - WY;
+    // Window pixels land 7 to the left of WX
+    for(int screenX = WX - 7; screenX < WIDTH; screenX++)
+    {
+        if(screenX < 0)
+            continue;
+        int x = screenX + 7 - WX;
+        u8 id = bus.Read8(map + ((y / 8) * 32) + (x / 8));
+        line[screenX] = BGPixel(bus, id, x % 8, y % 8);
+    }
+}
+
+void DrawSprites(Memory::MemoryBus& bus, Color* line)
+{
+    u8 LCDC = bus.Read8(0xFF40);
+    if(!(LCDC & 0x02))
+        return;
+    int height = (LCDC & 0x04)? 16 : 8;
+    // offset by 16 to align with Sprite y
+    int adjScanline = bus.Read8(0xFF44) + 16;
+
+    // The first 10 sprites on the line in OAM order, later ones on top
+    int count = 0;
+    for(int i = 0; i < 40 && count < 10; i++)
+    {
+        u16 oam = 0xFE00 + (i * 4);
+        int y = bus.Read8(oam);
+        int x = bus.Read8(oam + 1);
+        u8 id = bus.Read8(oam + 2);
+        u8 flags = bus.Read8(oam + 3);
+        if((y == 0 || y >= 160) || (x == 0 || x >= 168))
+            continue;
+        if(adjScanline < y || (adjScanline - y) >= height)
+            continue;
+        count++;
+
+        int oamY = (flags & 0x40)? ((height - 1) - (adjScanline - y)) : (adjScanline - y);
+        u16 address = 0x8000 + ((id + (oamY / 8)) * 16) + ((oamY % 8) * 2);
+        u8 low = bus.Read8(address);
+        u8 high = bus.Read8(address + 1);
+        u8 palette = bus.Read8((flags & 0x10)? 0xFF49 : 0xFF48);
+        for(int px = 0; px < 8; px++)
+        {
+            if(x + px < 8 || x + px >= 168)
+                continue;
+            int bit = (flags & 0x20)? px : 7 - px;
+            int color = (((high >> bit) & 1) << 1) | ((low >> bit) & 1);
+            // 00 is transparent for sprites
+            if(color == 0)
+                continue;
+            line[(x - 8) + px] = gColors[(palette >> (color * 2)) & 0x03];
+        }
+    }
+}
+
+}; // namespace Reference
@@ -0,0 +1,33 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "common/Types.h"
+
+
+namespace Memory {
+    class MemoryBus;
+}; // namespace Memory
+
+// Lines drawn the way the original renderer drew them, a pixel at
+// a time straight from VRAM and the registers, to check the PPU against
+namespace Reference {
+    // Background of the current line, as it goes on the top screen
+    void DrawBackground(Memory::MemoryBus& bus, Color* line);
+    // Window of the current line, over its line of the back buffer
+    void DrawWindow(Memory::MemoryBus& bus, Color* line);
+    // Sprites of the current line, over its line of the back buffer
+    void DrawSprites(Memory::MemoryBus& bus, Color* line);
+}; // namespace Reference
@@ -0,0 +1,97 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+#include "System.h"
+
+#include "core/RomImage.h"
+
+#include <cstdio>
+
+
+static const int BANKS = 8;
+
+// Every byte of a bank tells which bank it is
+static u8 BankByte(u32 bank, u32 offset)
+{
+    return static_cast<u8>((bank * 0x25) ^ offset ^ (offset >> 8));
+}
+
+static bool HoldsBank(const u8* data, u32 bank)
+{
+    for(u32 offset = 0; offset < Core::RomImage::BANK_SIZE; offset++)
+    {
+        if(data[offset] != BankByte(bank, offset))
+            return false;
+    }
+    return true;
+}
+
+static std::string WriteBanks()
+{
+    std::vector<u8> rom(BANKS * Core::RomImage::BANK_SIZE);
+    for(u32 i = 0; i < rom.size(); i++)
+        rom[i] = BankByte(i / Core::RomImage::BANK_SIZE, i % Core::RomImage::BANK_SIZE);
+    return System::WriteTemp(rom);
+}
+
+TEST(PagedBanksEvictAndPrefetch)
+{
+    std::string path = WriteBanks();
+    std::unique_ptr<Core::RomImage> image = Core::RomImage::OpenPaged(path, 2);
+    std::remove(path.c_str());
+    CHECK(image != nullptr);
+    Core::RomImage::Stats& stats = image->GetStats();
+    CHECK(HoldsBank(image->GetBank(0), 0));
+
+    // Bank 1 is mapped to start with; 1 -> 2 -> 3 -> 1 fills
+    // the pool, then evicts the least recently used bank
+    CHECK(HoldsBank(image->MapBank(1), 1));
+    CHECK(HoldsBank(image->MapBank(2), 2));
+    CHECK(HoldsBank(image->MapBank(3), 3));
+    CHECK(stats.faults == 3 && stats.evictions == 1);
+    // Mapping 1 again reads it back in, then reads ahead 2, its
+    // successor last time, into the slot that isn't mapped
+    CHECK(HoldsBank(image->MapBank(1), 1));
+    CHECK(stats.faults == 4 && stats.evictions == 3);
+    CHECK(stats.prefetches == 1 && stats.prefetch_hits == 0);
+    // Now 1 -> 2 -> 3 is all prefetch hits
+    CHECK(HoldsBank(image->MapBank(2), 2));
+    CHECK(HoldsBank(image->MapBank(3), 3));
+    CHECK(stats.faults == 4 && stats.evictions == 5);
+    CHECK(stats.prefetches == 3 && stats.prefetch_hits == 2);
+}
+
+TEST(PagedMappedBankStaysResident)
+{
+    std::string path = WriteBanks();
+    std::unique_ptr<Core::RomImage> image = Core::RomImage::OpenPaged(path, 2);
+    std::remove(path.c_str());
+    CHECK(image != nullptr);
+
+    // Reads of other banks go through the one free slot
+    const u8* mapped = image->MapBank(5);
+    for(int pass = 0; pass < 3; pass++)
+    {
+        for(u32 bank = 1; bank < BANKS; bank++)
+        {
+            CHECK(HoldsBank(image->GetBank(bank), bank));
+            CHECK(HoldsBank(mapped, 5));
+        }
+    }
+    // Every bank comes back right after being evicted
+    for(u32 bank = BANKS - 1; bank > 0; bank--)
+        CHECK(HoldsBank(image->MapBank(bank), bank));
+    CHECK(image->GetStats().evictions > BANKS);
+}
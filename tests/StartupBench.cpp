@@ -0,0 +1,73 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Bench.h"
+#include "System.h"
+
+#include "core/RomImage.h"
+#include "core/memory/MemoryBus.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+
+static const int RUNS = 20;
+
+// Writes a cartridge of random bytes to a temporary file
+static std::string WriteRom(u8 cart_type, int banks)
+{
+    std::vector<u8> rom = System::MakeRom(cart_type, banks);
+    std::mt19937 random(1);
+    for(size_t i = 0x0150; i < rom.size(); i++)
+        rom[i] = random();
+    return System::WriteTemp(rom);
+}
+
+template<typename Open>
+static void TimeOpen(const char* what, const char* size, Open open)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%s, %s", what, size);
+    Bench::Report(line, Bench::Time(RUNS, [&]() {
+        for(int i = 0; i < RUNS; i++)
+            Bench::sink += open();
+    }));
+}
+
+BENCHMARK(Startup)
+{
+    const struct { const char* name; u8 cart_type; int banks; } roms[] = {
+        { "32K", 0x00, 2 },
+        { "1M", 0x01, 64 },
+        { "8M", 0x13, 512 },
+    };
+    for(auto& rom : roms)
+    {
+        std::string path = WriteRom(rom.cart_type, rom.banks);
+        TimeOpen("RomImage::Open", rom.name, [&]() {
+            return Core::RomImage::Open(path)->GetBanks();
+        });
+        TimeOpen("RomImage::OpenPaged, 8 banks", rom.name, [&]() {
+            return Core::RomImage::OpenPaged(path, 8)->GetBanks();
+        });
+        TimeOpen("RomImage::Open and GameBoy", rom.name, [&]() {
+            Core::GameBoy::Options options;
+            options.skip_bootrom = true;
+            Core::GameBoy gameboy(options, 160, 144, Core::RomImage::Open(path), std::vector<u8>(0x100));
+            return gameboy.GetMemoryBus()->Read8(0x0150);
+        });
+        std::remove(path.c_str());
+    }
+}
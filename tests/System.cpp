@@ -0,0 +1,71 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "System.h"
+
+#include "core/PPU.h"
+#include "core/Scheduler.h"
+
+#include <3ds.h>
+
+#include <unistd.h>
+#include <utility>
+
+
+namespace System {
+
+std::vector<u8> MakeRom(u8 cart_type, int banks)
+{
+    std::vector<u8> rom(banks * Core::RomImage::BANK_SIZE, 0x00);
+    rom[0x0147] = cart_type;
+    return rom;
+}
+
+std::unique_ptr<Core::GameBoy> Make(const std::vector<u8>& rom, Core::GameBoy::Options options)
+{
+    options.skip_bootrom = true;
+    std::unique_ptr<Core::RomImage> image (new Core::RomImage(rom));
+    return std::unique_ptr<Core::GameBoy> (new Core::GameBoy(options, 160, 144, std::move(image), std::vector<u8>(0x100)));
+}
+
+std::unique_ptr<Core::GameBoy> Make(const std::vector<u8>& rom)
+{
+    return Make(rom, Core::GameBoy::Options());
+}
+
+std::string WriteTemp(const std::vector<u8>& rom)
+{
+    char path[] = "/tmp/jaxboyXXXXXX";
+    int fd = mkstemp(path);
+    write(fd, rom.data(), rom.size());
+    close(fd);
+    return path;
+}
+
+void StepPPU(Core::GameBoy& gameboy)
+{
+    gameboy.GetPPU()->Update(0);
+    gameboy.GetScheduler().Cancel(Core::EVENT_PPU);
+}
+
+Color ScreenPixel(int ly, int x)
+{
+    // The top screen is rotated, so a line is a column of it
+    u16 screenWidth;
+    u16 screenHeight;
+    Color* fb = (Color*) gfxGetFramebuffer(GFX_TOP, GFX_LEFT, &screenHeight, &screenWidth);
+    return fb[(x * screenHeight) + (144 - ly + (screenWidth * 2))];
+}
+
+}; // namespace System
@@ -0,0 +1,42 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "core/GameBoy.h"
+
+#include "common/Types.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Systems for tests and benchmarks to poke at
+namespace System {
+    // A cartridge of the given type and size, all zeros (NOPs)
+    // apart from the header
+    std::vector<u8> MakeRom(u8 cart_type, int banks);
+    // A system running rom from 0x0100, past the boot ROM
+    std::unique_ptr<Core::GameBoy> Make(const std::vector<u8>& rom, Core::GameBoy::Options options);
+    std::unique_ptr<Core::GameBoy> Make(const std::vector<u8>& rom);
+    // Writes rom to a new temporary file and returns its path
+    std::string WriteTemp(const std::vector<u8>& rom);
+
+    // Runs the PPU to the end of its current mode, with
+    // nothing else in the system moving
+    void StepPPU(Core::GameBoy& gameboy);
+    // Pixel x of line ly, as the PPU put it on the top screen
+    Color ScreenPixel(int ly, int x);
+}; // namespace System
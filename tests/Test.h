@@ -0,0 +1,42 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+
+// A test is a function that CHECKs things; a failed check
+// is reported and ends the function it's in
+namespace Test {
+    typedef void (*Function)();
+
+    struct Registration
+    {
+        Registration(const char* name, Function function);
+    };
+
+    void Fail(const char* file, int line, const char* expression);
+}; // namespace Test
+
+#define TEST(name)                                                  \
+    static void name();                                             \
+    static Test::Registration name##_registration(#name, name);     \
+    static void name()
+
+#define CHECK(expression)                                           \
+    do {                                                            \
+        if(!(expression)) {                                         \
+            Test::Fail(__FILE__, __LINE__, #expression);            \
+            return;                                                 \
+        }                                                           \
+    } while(0)
@@ -0,0 +1,72 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+namespace Test {
+
+struct Entry
+{
+    const char* name;
+    Function function;
+};
+
+static std::vector<Entry>& Entries()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+static int failures = 0;
+
+Registration::Registration(const char* name, Function function)
+{
+    Entries().push_back({ name, function });
+}
+
+void Fail(const char* file, int line, const char* expression)
+{
+    std::printf("    %s:%d: CHECK(%s) failed\n", file, line, expression);
+    failures++;
+}
+
+}; // namespace Test
+
+// Runs every test, or only those whose names contain the argument
+int main(int argc, char* argv[])
+{
+    int run = 0;
+    int failed = 0;
+    for(const Test::Entry& entry : Test::Entries())
+    {
+        if(argc > 1 && std::strstr(entry.name, argv[1]) == nullptr)
+            continue;
+
+        int before = Test::failures;
+        entry.function();
+        bool passed = (Test::failures == before);
+        std::printf("%s %s\n", passed? "[ OK ]" : "[FAIL]", entry.name);
+        run++;
+        if(!passed)
+            failed++;
+    }
+
+    std::printf("%d of %d tests passed\n", run - failed, run);
+    return (failed == 0)? 0 : 1;
+}
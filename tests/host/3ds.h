@@ -0,0 +1,28 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+
+// The parts of libctru the core uses, for host builds. The top
+// screen is rotated like the real one, 240 pixels across and 400 down
+enum gfxScreen_t { GFX_TOP, GFX_BOTTOM };
+enum gfx3dSide_t { GFX_LEFT, GFX_RIGHT };
+
+uint8_t* gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, uint16_t* width, uint16_t* height);
+void gfxFlushBuffers();
+void gfxSwapBuffers();
+void gspWaitForVBlank();
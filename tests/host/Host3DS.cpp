@@ -0,0 +1,39 @@
+// Copyright (C) 2017 Ryan Terry
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "3ds.h"
+
+
+static uint32_t framebuffers[2][240 * 400];
+static int current = 0;
+
+uint8_t* gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, uint16_t* width, uint16_t* height)
+{
+    if(width != nullptr)
+        *width = 240;
+    if(height != nullptr)
+        *height = 400;
+    return reinterpret_cast<uint8_t*>(framebuffers[current]);
+}
+
+void gfxFlushBuffers()
+{}
+
+void gfxSwapBuffers()
+{
+    current ^= 1;
+}
+
+void gspWaitForVBlank()
+{}